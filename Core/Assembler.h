@@ -14,6 +14,8 @@ struct Executable
 {
     std::vector<uint8_t> machineCode;
     std::map<int,uint8_t> initialRAM; 
+    std::map<int,std::string> codeLabels; // ROM address -> first label defined there
+    std::map<int,int> lineAddresses;      // source line index -> ROM address it assembles to
 };
 
 struct CompileResult {
@@ -108,6 +110,7 @@ public:
             // Just label such as "LOOP:"
             if (temp.back() == ':'){
                 symbolTable[temp.substr(0,temp.length()-1)] = addr;
+                result.exe.codeLabels.emplace(addr, temp.substr(0,temp.length()-1));
                 continue; // label doesn't take up space in tag memory; 
             }
             size_t col = temp.find(':');
@@ -115,6 +118,7 @@ public:
             if (col != std::string::npos)
             {
                 symbolTable[Trim(temp.substr(0,col))] = addr; // save the text before the : as a label.
+                result.exe.codeLabels.emplace(addr, Trim(temp.substr(0,col)));
                 temp = Trim(temp.substr(col+1)); //continue processing the remaining part.
             }
             std::stringstream ls(temp);
@@ -133,6 +137,7 @@ public:
         for (size_t i = 0; i < codeLines.size(); ++i) {   
             // instruct
             std::string temp = codeLines[i];
+            result.exe.lineAddresses[originalLineIndices[i]] = (int)result.exe.machineCode.size(); // a label-only line maps to the next instruction
             if (temp.back() == ':') continue;
             size_t col = temp.find(':');
             if (col != std::string::npos) temp = Trim(temp.substr(col+1)); // clip label , take instruct
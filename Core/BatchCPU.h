@@ -0,0 +1,382 @@
+#ifndef BATCH_CPU_H
+#define BATCH_CPU_H
+
+// Structure-of-arrays engine that runs many CPU4bit instances of the same ROM in lockstep.
+//
+// Every register, flag and RAM cell is stored as one byte per instance ("lane"), cell by cell,
+// so ALU instructions (LDA/LDI/STA/ADD/SUB/AND/OR/XOR/NOT) and jumps execute as byte-vector
+// operations over all lanes at once (AVX2: 32 lanes, SSE2: 16 lanes, scalar fallback: 1).
+// Lanes whose PC differs are masked out: each step executes the instruction at the lowest PC
+// among running lanes, which lets lanes that fell behind catch up and reconverge.
+// Indirect addressing, stack and control instructions (LDAI, STAI, CALL, RET, PUSH, POP, RST,
+// HLT, LDA 14) run per lane.
+//
+// Results per lane match a separate CPU4bit fed the same inputs (console text is not modelled).
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "CPU.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Batch {
+
+#if defined(__AVX2__)
+    struct Vec {
+        __m256i v;
+        static const size_t WIDTH = 32;
+        static Vec Load(const uint8_t* p){ return { _mm256_loadu_si256((const __m256i*)p) }; }
+        void Store(uint8_t* p) const { _mm256_storeu_si256((__m256i*)p, v); }
+        static Vec Set(uint8_t x){ return { _mm256_set1_epi8((char)x) }; }
+        static Vec Add(Vec a, Vec b){ return { _mm256_add_epi8(a.v, b.v) }; }
+        static Vec AddSat(Vec a, Vec b){ return { _mm256_adds_epu8(a.v, b.v) }; }
+        static Vec Sub(Vec a, Vec b){ return { _mm256_sub_epi8(a.v, b.v) }; }
+        static Vec SubSat(Vec a, Vec b){ return { _mm256_subs_epu8(a.v, b.v) }; }
+        static Vec And(Vec a, Vec b){ return { _mm256_and_si256(a.v, b.v) }; }
+        static Vec Or(Vec a, Vec b){ return { _mm256_or_si256(a.v, b.v) }; }
+        static Vec Xor(Vec a, Vec b){ return { _mm256_xor_si256(a.v, b.v) }; }
+        static Vec Eq(Vec a, Vec b){ return { _mm256_cmpeq_epi8(a.v, b.v) }; }
+        static Vec Min(Vec a, Vec b){ return { _mm256_min_epu8(a.v, b.v) }; }
+        static Vec Select(Vec mask, Vec a, Vec b){ return { _mm256_blendv_epi8(b.v, a.v, mask.v) }; } // mask ? a : b
+    };
+#elif defined(__SSE2__)
+    struct Vec {
+        __m128i v;
+        static const size_t WIDTH = 16;
+        static Vec Load(const uint8_t* p){ return { _mm_loadu_si128((const __m128i*)p) }; }
+        void Store(uint8_t* p) const { _mm_storeu_si128((__m128i*)p, v); }
+        static Vec Set(uint8_t x){ return { _mm_set1_epi8((char)x) }; }
+        static Vec Add(Vec a, Vec b){ return { _mm_add_epi8(a.v, b.v) }; }
+        static Vec AddSat(Vec a, Vec b){ return { _mm_adds_epu8(a.v, b.v) }; }
+        static Vec Sub(Vec a, Vec b){ return { _mm_sub_epi8(a.v, b.v) }; }
+        static Vec SubSat(Vec a, Vec b){ return { _mm_subs_epu8(a.v, b.v) }; }
+        static Vec And(Vec a, Vec b){ return { _mm_and_si128(a.v, b.v) }; }
+        static Vec Or(Vec a, Vec b){ return { _mm_or_si128(a.v, b.v) }; }
+        static Vec Xor(Vec a, Vec b){ return { _mm_xor_si128(a.v, b.v) }; }
+        static Vec Eq(Vec a, Vec b){ return { _mm_cmpeq_epi8(a.v, b.v) }; }
+        static Vec Min(Vec a, Vec b){ return { _mm_min_epu8(a.v, b.v) }; }
+        static Vec Select(Vec mask, Vec a, Vec b){ return { _mm_or_si128(_mm_and_si128(mask.v, a.v), _mm_andnot_si128(mask.v, b.v)) }; }
+    };
+#else
+    // Scalar fallback: one lane per "vector", masks are 0x00 / 0xFF like the SIMD versions
+    struct Vec {
+        uint8_t v;
+        static const size_t WIDTH = 1;
+        static Vec Load(const uint8_t* p){ return { *p }; }
+        void Store(uint8_t* p) const { *p = v; }
+        static Vec Set(uint8_t x){ return { x }; }
+        static Vec Add(Vec a, Vec b){ return { (uint8_t)(a.v + b.v) }; }
+        static Vec AddSat(Vec a, Vec b){ int s = a.v + b.v; return { (uint8_t)(s > 255 ? 255 : s) }; }
+        static Vec Sub(Vec a, Vec b){ return { (uint8_t)(a.v - b.v) }; }
+        static Vec SubSat(Vec a, Vec b){ return { (uint8_t)(a.v > b.v ? a.v - b.v : 0) }; }
+        static Vec And(Vec a, Vec b){ return { (uint8_t)(a.v & b.v) }; }
+        static Vec Or(Vec a, Vec b){ return { (uint8_t)(a.v | b.v) }; }
+        static Vec Xor(Vec a, Vec b){ return { (uint8_t)(a.v ^ b.v) }; }
+        static Vec Eq(Vec a, Vec b){ return { (uint8_t)(a.v == b.v ? 0xFF : 0x00) }; }
+        static Vec Min(Vec a, Vec b){ return { a.v < b.v ? a.v : b.v }; }
+        static Vec Select(Vec mask, Vec a, Vec b){ return { (uint8_t)((mask.v & a.v) | (~mask.v & b.v)) }; }
+    };
+#endif
+
+    inline Vec IsZero(Vec a){ return Vec::Eq(a, Vec::Set(0)); }
+    inline Vec IsNonZero(Vec a){ return Vec::Xor(IsZero(a), Vec::Set(0xFF)); }
+    inline Vec ToFlag(Vec mask){ return Vec::And(mask, Vec::Set(1)); } // 0xFF/0x00 -> 1/0
+}
+
+class CPU4bitBatch {
+public:
+    static const size_t VECTOR_LANES = Batch::Vec::WIDTH;
+
+    // Every lane starts as a copy of `prototype` (ROM, RAM, registers).
+    CPU4bitBatch(const CPU4bit& prototype, size_t instances) : count(instances) {
+        padded = (instances + VECTOR_LANES - 1) / VECTOR_LANES * VECTOR_LANES;
+        if (padded == 0) padded = VECTOR_LANES;
+        rom = prototype.ROM;
+        // Devices attached to the prototype are not shared with the lanes: plain RAM/port decode
+        for (int addr = 0; addr < 256; ++addr) decoded[addr] = Decode::DecodeAt(rom.data(), (uint8_t)addr);
+
+        acc.assign(padded, prototype.ACC);
+        pc.assign(padded, prototype.PC);
+        ir.assign(padded, prototype.IR);
+        sp.assign(padded, prototype.SP);
+        z.assign(padded, prototype.Z ? 1 : 0);
+        c.assign(padded, prototype.C ? 1 : 0);
+        leds.assign(padded, prototype.getGPIO().getLEDs());
+        halted.assign(padded, prototype.halted ? 1 : 0);
+        waiting.assign(padded, prototype.isWaitingForInput ? 1 : 0);
+        mask.assign(padded, 0);
+        running.assign(padded, 0);
+        stepCount.assign(padded, 0);
+        for (int i = 0; i < 16; ++i)
+        {
+            ram[i].assign(padded, prototype.RAM[i]);
+            stack[i].assign(padded, prototype.STACK[i]);
+        }
+        inputs.resize(padded);
+        nextInput.assign(padded, 0);
+        executed.assign(padded, 0);
+        // padding lanes never run
+        for (size_t l = count; l < padded; ++l) halted[l] = 1;
+    }
+
+    size_t Size() const { return count; }
+
+    void SetRAM(size_t lane, int addr, uint8_t val){
+        if (lane < count && addr >= 0 && addr < 16) ram[addr][lane] = val & 0xF;
+    }
+
+    // Values answered to LDA 14, in order. A lane with no input left stops waiting for input.
+    void SetInputs(size_t lane, const std::vector<uint8_t>& values){
+        if (lane < count) { inputs[lane] = values; nextInput[lane] = 0; }
+    }
+
+    // Runs every lane until HLT, an unanswerable input request, or `budget` instructions
+    // (per lane, counted from this call). Returns the total number of instructions executed.
+    uint64_t Run(uint64_t budget){
+        std::fill(executed.begin(), executed.end(), 0);
+        std::fill(stepCount.begin(), stepCount.end(), 0);
+        for (size_t l = 0; l < count; ++l)
+        {
+            ResolvePendingInput(l);
+            running[l] = (!halted[l] && !waiting[l] && budget > 0) ? 0xFF : 0x00;
+        }
+
+        // A lane executes at most one instruction per step, so no lane can reach the
+        // budget before `steps` does; per-lane counters are only checked after that.
+        uint64_t steps = 0;
+        int sinceFlush = 0;
+        int target = LowestRunningPC();
+        while (target >= 0)
+        {
+            ExecuteMasked((uint8_t)target);
+            steps++;
+            if (++sinceFlush == 255 || steps >= budget) {
+                FlushStepCounts();
+                sinceFlush = 0;
+                if (steps >= budget) {
+                    for (size_t l = 0; l < count; ++l) if (executed[l] >= budget) running[l] = 0;
+                }
+            }
+            target = LowestRunningPC();
+        }
+        FlushStepCounts();
+
+        uint64_t total = 0;
+        for (size_t l = 0; l < count; ++l) total += executed[l];
+        return total;
+    }
+
+    // Copies one lane into a regular CPU4bit (which must hold the same program).
+    void ReadLane(size_t lane, CPU4bit& cpu) const {
+        cpu.ACC = acc[lane]; cpu.PC = pc[lane]; cpu.IR = ir[lane]; cpu.SP = sp[lane];
+        cpu.Z = z[lane] != 0; cpu.C = c[lane] != 0;
+        cpu.halted = halted[lane] != 0; cpu.isWaitingForInput = waiting[lane] != 0;
+        for (int i = 0; i < 16; ++i) { cpu.RAM[i] = ram[i][lane]; cpu.STACK[i] = stack[i][lane]; }
+        cpu.getGPIO().WriteOutputPort(leds[lane]);
+    }
+
+    uint64_t Executed(size_t lane) const { return executed[lane]; }
+    bool Halted(size_t lane) const { return halted[lane] != 0; }
+    bool WaitingForInput(size_t lane) const { return waiting[lane] != 0; }
+    uint8_t LEDs(size_t lane) const { return leds[lane]; }
+    uint8_t ACC(size_t lane) const { return acc[lane]; }
+
+private:
+    size_t count;
+    size_t padded;
+    std::array<uint8_t, 256> rom;
+    std::array<Decode::DecodedOp, 256> decoded;
+
+    // one byte per lane
+    std::vector<uint8_t> acc, pc, ir, sp, z, c, leds, halted, waiting;
+    std::vector<uint8_t> running;   // 0xFF while the lane may execute in this Run()
+    std::vector<uint8_t> mask;      // 0xFF for lanes executing the current step
+    std::vector<uint8_t> stepCount; // instructions since the last flush into `executed` (< 256)
+    std::vector<uint8_t> ram[16];
+    std::vector<uint8_t> stack[16];
+
+    std::vector<std::vector<uint8_t>> inputs;
+    std::vector<size_t> nextInput;
+    std::vector<uint64_t> executed;
+
+    int LowestRunningPC() const {
+        using Batch::Vec;
+        Vec lowest = Vec::Set(0xFF);
+        Vec any = Vec::Set(0);
+        for (size_t base = 0; base < padded; base += VECTOR_LANES)
+        {
+            Vec run = Vec::Load(&running[base]);
+            lowest = Vec::Min(lowest, Vec::Select(run, Vec::Load(&pc[base]), Vec::Set(0xFF)));
+            any = Vec::Or(any, run);
+        }
+        uint8_t lanesLowest[VECTOR_LANES], lanesAny[VECTOR_LANES];
+        lowest.Store(lanesLowest);
+        any.Store(lanesAny);
+        int result = -1;
+        for (size_t i = 0; i < VECTOR_LANES; ++i)
+        {
+            if (lanesAny[i] && (result < 0 || lanesLowest[i] < result)) result = lanesLowest[i];
+        }
+        return result;
+    }
+
+    void FlushStepCounts(){
+        for (size_t l = 0; l < padded; ++l) { executed[l] += stepCount[l]; stepCount[l] = 0; }
+    }
+
+    void ResolvePendingInput(size_t l){
+        if (!waiting[l] || nextInput[l] >= inputs[l].size()) return;
+        uint8_t val = inputs[l][nextInput[l]++] & 0xF;
+        acc[l] = val;
+        ram[14][l] = val;
+        z[l] = (val == 0);
+        waiting[l] = 0;
+    }
+
+    void StopLane(size_t l){ running[l] = 0; }
+
+    void ResetLane(size_t l){
+        pc[l] = 0; sp[l] = 0; acc[l] = 0; z[l] = 0; c[l] = 0;
+        halted[l] = 0; waiting[l] = 0; leds[l] = 0;
+        for (int i = 0; i < 16; ++i) ram[i][l] = 0;
+    }
+
+    // Writes the new accumulator and Z flag for masked lanes of one vector chunk.
+    static void CommitAcc(Batch::Vec m, Batch::Vec newAcc, uint8_t* accp, uint8_t* zp){
+        using Batch::Vec;
+        Vec::Select(m, newAcc, Vec::Load(accp)).Store(accp);
+        Vec::Select(m, Batch::ToFlag(Batch::IsZero(newAcc)), Vec::Load(zp)).Store(zp);
+    }
+
+    void ExecuteMasked(uint8_t at){
+        using Batch::Vec;
+        const Decode::DecodedOp op = decoded[at];
+        const uint8_t fall = (uint8_t)(at + op.length);
+        const Vec irVal = Vec::Set(rom[at]);
+        const Vec nextVal = Vec::Set(fall);
+        const Vec low = Vec::Set(0x0F);
+
+        // Vector part: select lanes, fetch (IR, PC) and the ALU/jump instructions
+        const Vec targetVal = Vec::Set(at);
+        for (size_t base = 0; base < padded; base += VECTOR_LANES)
+        {
+            const Vec m = Vec::And(Vec::Load(&running[base]), Vec::Eq(Vec::Load(&pc[base]), targetVal));
+            m.Store(&mask[base]);
+            Vec::Add(Vec::Load(&stepCount[base]), Batch::ToFlag(m)).Store(&stepCount[base]);
+            uint8_t* accp = &acc[base];
+            uint8_t* zp = &z[base];
+            uint8_t* cp = &c[base];
+            Vec::Select(m, irVal, Vec::Load(&ir[base])).Store(&ir[base]);
+            Vec newPC = nextVal;
+
+            switch (op.handler)
+            {
+            case Decode::OP_LDA:
+                CommitAcc(m, Vec::Load(&ram[op.operand][base]), accp, zp);
+                break;
+            case Decode::OP_LDI:
+                CommitAcc(m, Vec::Set(op.operand), accp, zp);
+                break;
+            case Decode::OP_STA:
+            case Decode::OP_STA_GPIO:
+                {
+                    Vec val = Vec::And(Vec::Load(accp), low);
+                    uint8_t* cell = &ram[op.operand][base];
+                    Vec::Select(m, val, Vec::Load(cell)).Store(cell);
+                    if (op.handler == Decode::OP_STA_GPIO) Vec::Select(m, val, Vec::Load(&leds[base])).Store(&leds[base]);
+                }
+                break;
+            case Decode::OP_ADD:
+                {
+                    Vec a = Vec::Load(accp), r = Vec::Load(&ram[op.operand][base]);
+                    // carry: the untruncated sum exceeds 15 (saturating add keeps >255 visible)
+                    Vec carry = Batch::IsNonZero(Vec::And(Vec::AddSat(a, r), Vec::Set(0xF0)));
+                    Vec::Select(m, Batch::ToFlag(carry), Vec::Load(cp)).Store(cp);
+                    CommitAcc(m, Vec::And(Vec::Add(a, r), low), accp, zp);
+                }
+                break;
+            case Decode::OP_SUB:
+                {
+                    Vec a = Vec::Load(accp), r = Vec::Load(&ram[op.operand][base]);
+                    Vec borrow = Batch::IsNonZero(Vec::SubSat(r, a)); // r > a
+                    Vec::Select(m, Batch::ToFlag(borrow), Vec::Load(cp)).Store(cp);
+                    CommitAcc(m, Vec::And(Vec::Sub(a, r), low), accp, zp);
+                }
+                break;
+            case Decode::OP_AND:
+                CommitAcc(m, Vec::And(Vec::Load(accp), Vec::Load(&ram[op.operand][base])), accp, zp);
+                break;
+            case Decode::OP_OR:
+                CommitAcc(m, Vec::Or(Vec::Load(accp), Vec::Load(&ram[op.operand][base])), accp, zp);
+                break;
+            case Decode::OP_XOR:
+                CommitAcc(m, Vec::Xor(Vec::Load(accp), Vec::Load(&ram[op.operand][base])), accp, zp);
+                break;
+            case Decode::OP_NOT:
+                CommitAcc(m, Vec::And(Vec::Xor(Vec::Load(accp), Vec::Set(0xFF)), low), accp, zp);
+                break;
+            case Decode::OP_JMP:
+                newPC = Vec::Set(op.target);
+                break;
+            case Decode::OP_JZ:
+                newPC = Vec::Select(Batch::IsNonZero(Vec::Load(zp)), Vec::Set(op.target), nextVal);
+                break;
+            case Decode::OP_JC:
+                newPC = Vec::Select(Batch::IsNonZero(Vec::Load(cp)), Vec::Set(op.target), nextVal);
+                break;
+            default:
+                break; // NOP and the per-lane instructions below
+            }
+            Vec::Select(m, newPC, Vec::Load(&pc[base])).Store(&pc[base]);
+        }
+
+        // Per-lane part (PC already points past the instruction)
+        switch (op.handler)
+        {
+        case Decode::OP_INPUT:
+            ForMasked([&](size_t l){ waiting[l] = 1; ResolvePendingInput(l); if (waiting[l]) StopLane(l); });
+            break;
+        case Decode::OP_LDAI:
+            ForMasked([&](size_t l){ acc[l] = ram[ram[op.operand][l] & 0xF][l]; z[l] = (acc[l] == 0); });
+            break;
+        case Decode::OP_STAI:
+            ForMasked([&](size_t l){ ram[ram[op.operand][l] & 0xF][l] = acc[l]; });
+            break;
+        case Decode::OP_CALL:
+            ForMasked([&](size_t l){
+                if (sp[l] < 16) { stack[sp[l]][l] = (uint8_t)(fall); sp[l]++; }
+                pc[l] = op.target;
+            });
+            break;
+        case Decode::OP_HLT:
+            ForMasked([&](size_t l){ halted[l] = 1; StopLane(l); });
+            break;
+        case Decode::OP_RST:
+            ForMasked([&](size_t l){ ResetLane(l); });
+            break;
+        case Decode::OP_PUSH:
+            ForMasked([&](size_t l){ if (sp[l] < 16) { stack[sp[l]][l] = acc[l]; sp[l]++; } });
+            break;
+        case Decode::OP_POP:
+            ForMasked([&](size_t l){ if (sp[l] > 0) { sp[l]--; acc[l] = stack[sp[l]][l]; } });
+            break;
+        case Decode::OP_RET:
+            ForMasked([&](size_t l){ if (sp[l] > 0) { sp[l]--; pc[l] = stack[sp[l]][l]; } });
+            break;
+        default:
+            break;
+        }
+    }
+
+    template <class Fn>
+    void ForMasked(Fn fn){
+        for (size_t l = 0; l < count; ++l) if (mask[l]) fn(l);
+    }
+};
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+// PC breakpoints, RAM watchpoints and conditional breakpoints.
+//
+// PC breakpoints are a 256-bit bitmap over ROM addresses, watchpoints two 16-bit masks over
+// the RAM cells (read, write). Conditions ("ACC==7 && Z") are compiled into a few fixed-size
+// terms and kept in a small table, so the whole set is trivially copyable and can travel
+// through the sim thread's command queue.
+//
+// Use as a RunHooked() observer, or run with Run(), which keeps the CPU's own engine: only the
+// instructions that can hit are trapped (CPU4bit::SetTraps) and single-stepped through the
+// observer. Callers only involve it while Any() is true, so a run without breakpoints keeps its
+// plain loop. A PC breakpoint stops the run before the instruction at that address executes
+// (the first instruction of a run is never checked, so RUN continues past the breakpoint it
+// stopped at); a watchpoint stops right after the instruction that touched the cell.
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include "CPU.h"
+
+// Keeps Run()'s rare paths out of the caller, so the common call stays a few compares
+// around the engine run.
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU4BIT_NOINLINE __attribute__((noinline))
+#else
+#define CPU4BIT_NOINLINE
+#endif
+
+// OR of AND-groups over registers, flags and RAM cells, e.g. "ACC==7 && Z || [3]>2".
+// Operands: ACC, PC, SP, IR, Z, C, [n] / RAM[n]; comparisons ==, !=, <, <=, >, >=;
+// a bare operand means "!= 0" and a leading '!' means "== 0".
+struct BreakCondition {
+    static const int MAX_TERMS = 8;
+
+    enum Operand : uint8_t { ACC, PC, SP, IR, FLAG_Z, FLAG_C, CELL0 }; // CELL0 + n = RAM[n]
+    enum Compare : uint8_t { EQ, NE, LT, LE, GT, GE };
+
+    struct Term {
+        uint8_t operand;
+        uint8_t compare;
+        uint8_t value;
+        uint8_t startsGroup; // an '||' precedes this term
+    };
+
+    Term terms[MAX_TERMS] = {};
+    uint8_t count = 0;
+
+    bool Always() const { return count == 0; }
+
+    bool Eval(const CPUState& s) const {
+        bool result = false, group = true;
+        for (int i = 0; i < count; ++i)
+        {
+            const Term& t = terms[i];
+            if (t.startsGroup) { result = result || group; group = true; }
+            group = group && Test(t, Read(s, t.operand));
+        }
+        return result || group;
+    }
+
+    // Returns false (and a message) for text that is not a condition.
+    static bool Parse(const std::string& text, BreakCondition& out, std::string& error){
+        out = BreakCondition();
+        size_t pos = 0;
+        bool startsGroup = false;
+        while (true)
+        {
+            if (out.count == MAX_TERMS) { error = "too many comparisons (max 8)"; return false; }
+            Term t = {};
+            t.startsGroup = startsGroup;
+            bool negate = Accept(text, pos, "!");
+            if (!ParseOperand(text, pos, t.operand)) { error = "expected ACC, PC, SP, IR, Z, C or [cell]"; return false; }
+            if (!ParseCompare(text, pos, t.compare)) {
+                t.compare = negate ? EQ : NE;
+                t.value = 0;
+            } else {
+                if (negate) { error = "'!' cannot be combined with a comparison"; return false; }
+                if (!ParseNumber(text, pos, t.value)) { error = "expected a number"; return false; }
+            }
+            out.terms[out.count++] = t;
+
+            SkipSpace(text, pos);
+            if (pos == text.size()) return true;
+            if (Accept(text, pos, "&&")) startsGroup = false;
+            else if (Accept(text, pos, "||")) startsGroup = true;
+            else { error = "unexpected '" + text.substr(pos, 1) + "'"; return false; }
+        }
+    }
+
+    // Condition written as an "; if ..." comment on a source line, e.g. "ADD [3] ; if ACC==7 && Z".
+    // A line without such a comment gives an unconditional breakpoint.
+    static bool FromSourceLine(const std::string& line, BreakCondition& out, std::string& error){
+        out = BreakCondition();
+        size_t comment = line.find(';');
+        if (comment == std::string::npos) return true;
+        size_t pos = comment + 1;
+        SkipSpace(line, pos);
+        if (line.size() < pos + 3 || std::toupper((unsigned char)line[pos]) != 'I' ||
+            std::toupper((unsigned char)line[pos + 1]) != 'F' || !std::isspace((unsigned char)line[pos + 2])) {
+            return true; // an ordinary comment
+        }
+        return Parse(line.substr(pos + 3), out, error);
+    }
+
+private:
+    static uint8_t Read(const CPUState& s, uint8_t operand){
+        switch (operand)
+        {
+        case ACC: return s.ACC;
+        case PC: return s.PC;
+        case SP: return s.SP;
+        case IR: return s.IR;
+        case FLAG_Z: return s.Z;
+        case FLAG_C: return s.C;
+        default: return s.ReadRAM((uint8_t)(operand - CELL0));
+        }
+    }
+
+    static bool Test(const Term& t, uint8_t v){
+        switch (t.compare)
+        {
+        case EQ: return v == t.value;
+        case NE: return v != t.value;
+        case LT: return v < t.value;
+        case LE: return v <= t.value;
+        case GT: return v > t.value;
+        default: return v >= t.value;
+        }
+    }
+
+    static void SkipSpace(const std::string& text, size_t& pos){
+        while (pos < text.size() && std::isspace((unsigned char)text[pos])) pos++;
+    }
+
+    static bool Accept(const std::string& text, size_t& pos, const char* token){
+        SkipSpace(text, pos);
+        size_t n = std::char_traits<char>::length(token);
+        if (text.compare(pos, n, token) != 0) return false;
+        pos += n;
+        return true;
+    }
+
+    static bool ParseNumber(const std::string& text, size_t& pos, uint8_t& out){
+        SkipSpace(text, pos);
+        const char* start = text.c_str() + pos;
+        char* end = nullptr;
+        long v = std::strtol(start, &end, 0);
+        if (end == start || v < 0 || v > 255) return false;
+        pos += (size_t)(end - start);
+        out = (uint8_t)v;
+        return true;
+    }
+
+    static bool ParseOperand(const std::string& text, size_t& pos, uint8_t& out){
+        SkipSpace(text, pos);
+        size_t start = pos;
+        while (pos < text.size() && std::isalpha((unsigned char)text[pos])) pos++;
+        std::string word = text.substr(start, pos - start);
+        for (char& ch : word) ch = (char)std::toupper((unsigned char)ch);
+
+        if (word == "ACC" || word == "A") { out = ACC; return true; }
+        if (word == "PC") { out = PC; return true; }
+        if (word == "SP") { out = SP; return true; }
+        if (word == "IR") { out = IR; return true; }
+        if (word == "Z") { out = FLAG_Z; return true; }
+        if (word == "C") { out = FLAG_C; return true; }
+        if (word.empty() || word == "RAM") {
+            uint8_t cell = 0;
+            if (!Accept(text, pos, "[") || !ParseNumber(text, pos, cell) || cell > 15 || !Accept(text, pos, "]")) return false;
+            out = (uint8_t)(CELL0 + cell);
+            return true;
+        }
+        return false;
+    }
+
+    static bool ParseCompare(const std::string& text, size_t& pos, uint8_t& out){
+        if (Accept(text, pos, "==")) { out = EQ; return true; }
+        if (Accept(text, pos, "!=")) { out = NE; return true; }
+        if (Accept(text, pos, "<=")) { out = LE; return true; }
+        if (Accept(text, pos, ">=")) { out = GE; return true; }
+        if (Accept(text, pos, "<")) { out = LT; return true; }
+        if (Accept(text, pos, ">")) { out = GT; return true; }
+        return false;
+    }
+};
+
+enum BreakKind : uint8_t {
+    BREAK_NONE = 0,
+    BREAK_PC,      // `where` = ROM address about to execute
+    BREAK_READ,    // `where` = RAM cell that was read
+    BREAK_WRITE    // `where` = RAM cell that was written
+};
+
+struct BreakHit {
+    uint8_t kind = BREAK_NONE;
+    uint8_t where = 0;
+};
+
+class Breakpoints : public NoHooks {
+public:
+    static const int MAX_CONDITIONS = 16;
+
+    bool Any() const { return (pcBits[0] | pcBits[1] | pcBits[2] | pcBits[3]) != 0 || (readWatch | writeWatch) != 0; }
+    bool HasPC(uint8_t addr) const { return (pcBits[addr >> 6] >> (addr & 63)) & 1; }
+    bool HasCondition(uint8_t addr) const { return FindCondition(addr) >= 0; }
+
+    void Clear(){ *this = Breakpoints(); }
+
+    // Sets or replaces the breakpoint at `addr`; false if the condition table is full.
+    bool SetPC(uint8_t addr, const BreakCondition& condition = BreakCondition()){
+        installedDispatch = 0;
+        int slot = FindCondition(addr);
+        if (!condition.Always()) {
+            if (slot < 0) slot = FindCondition(-1);
+            if (slot < 0) return false;
+            conditionAddr[slot] = addr;
+            conditions[slot] = condition;
+        } else if (slot >= 0) {
+            conditionAddr[slot] = -1;
+        }
+        pcBits[addr >> 6] |= 1ULL << (addr & 63);
+        return true;
+    }
+
+    void RemovePC(uint8_t addr){
+        installedDispatch = 0;
+        int slot = FindCondition(addr);
+        if (slot >= 0) conditionAddr[slot] = -1;
+        pcBits[addr >> 6] &= ~(1ULL << (addr & 63));
+    }
+
+    void TogglePC(uint8_t addr){
+        if (HasPC(addr)) RemovePC(addr); else SetPC(addr);
+    }
+
+    uint16_t ReadWatch() const { return readWatch; }   // bit n: stop after an instruction reads RAM[n]
+    uint16_t WriteWatch() const { return writeWatch; } // bit n: stop after an instruction writes RAM[n]
+
+    void SetWatch(uint16_t read, uint16_t write){
+        installedDispatch = 0;
+        readWatch = read;
+        writeWatch = write;
+    }
+
+    // Cycles a cell through off -> write -> read+write -> read -> off.
+    void CycleWatch(uint8_t cell){
+        installedDispatch = 0;
+        uint16_t bit = (uint16_t)(1u << (cell & 0xF));
+        bool r = readWatch & bit, w = writeWatch & bit;
+        if (!r && !w) { writeWatch |= bit; }
+        else if (!r && w) { readWatch |= bit; }
+        else if (r && w) { writeWatch &= (uint16_t)~bit; }
+        else { readWatch &= (uint16_t)~bit; }
+    }
+
+    const BreakHit& Hit() const { return hit; }
+    void ClearHit(){ hit = BreakHit(); }
+
+    // Runs like cpu.RunFor(budget) and stops where RunHooked(*this, budget) would (reason
+    // Predicate, see Hit()). Breakpoint addresses and every instruction that may touch a
+    // watched cell are trapped; the CPU's engine runs everything in between. The traps stay
+    // installed for the next call, so call cpu.ClearTraps() before running it without this.
+    // While the set, the program and the CPU's traps are unchanged, a call only compares the
+    // CPU's dispatch version before entering the engine.
+    RunResult Run(CPU4bit& cpu, uint64_t budget){
+        if (installedDispatch != cpu.dispatchVersion) InstallTraps(cpu);
+        // The common case is one engine run that ends on its own (HLT, input, budget) at an
+        // untrapped address, where nothing can hit. A run that starts on a trapped instruction
+        // stops at once, having executed nothing.
+        RunResult result = cpu.RunFor(budget);
+        if (!cpu.Trapped(cpu.PC)) return result;
+        return RunTrapped(cpu, budget, result);
+    }
+
+    // ROM addresses Run() has to single-step: PC breakpoints, plus the instructions that can
+    // touch a watched cell (every LDAI/STAI, since their cell is only known at run time).
+    std::array<uint64_t, 4> TrapAddresses(const CPU4bit& cpu) const {
+        std::array<uint64_t, 4> bits = pcBits;
+        if ((readWatch | writeWatch) == 0) return bits;
+        for (int addr = 0; addr < 256; ++addr)
+        {
+            uint16_t reads = 0, writes = 0;
+            Access(cpu.decoded[addr], 0xFFFF, reads, writes);
+            if ((reads & readWatch) | (writes & writeWatch)) bits[addr >> 6] |= 1ULL << (addr & 63);
+        }
+        return bits;
+    }
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        if ((readWatch | writeWatch) == 0) return;
+        uint16_t reads = 0, writes = 0;
+        if (op.handler == Decode::OP_LDAI || op.handler == Decode::OP_STAI) {
+            Access(op, Bit(cpu.ReadRAM(op.operand)), reads, writes);
+        } else {
+            Access(op, 0, reads, writes);
+        }
+        if (writes & writeWatch) pending = { BREAK_WRITE, LowestCell(writes & writeWatch) };
+        else if (reads & readWatch) pending = { BREAK_READ, LowestCell(reads & readWatch) };
+    }
+
+    bool AfterExecute(const CPU4bit& cpu){
+        if (!(pending.kind | HasPC(cpu.PC))) return false; // the common case: one branch
+        if (pending.kind != BREAK_NONE) {
+            BreakHit touched = pending;
+            pending = BreakHit();
+            // An LDA 14 that is still waiting has not stored anything yet.
+            if (!cpu.isWaitingForInput) {
+                hit = touched;
+                return true;
+            }
+        }
+        return CheckPC(cpu);
+    }
+
+    // Call after the host completed a waiting LDA 14 (ResolveInput()/PollInput() returned
+    // true): the value is in RAM[14] now, so a write watch there hits. Returns true on a hit.
+    bool InputDelivered(){
+        if (!(writeWatch & Bit(14))) return false;
+        hit = { BREAK_WRITE, 14 };
+        return true;
+    }
+
+private:
+    std::array<uint64_t, 4> pcBits = {};
+    uint16_t readWatch = 0;
+    uint16_t writeWatch = 0;
+    std::array<int16_t, MAX_CONDITIONS> conditionAddr = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+    std::array<BreakCondition, MAX_CONDITIONS> conditions = {};
+    BreakHit pending;
+    BreakHit hit;
+
+    // The dispatch version of the CPU Run() last installed this set's traps on, right after
+    // installing them (see CPU4bit::dispatchVersion). Every change to the set resets it.
+    uint64_t installedDispatch = 0;
+
+    CPU4BIT_NOINLINE void InstallTraps(CPU4bit& cpu){
+        cpu.SetTraps(TrapAddresses(cpu));
+        installedDispatch = cpu.dispatchVersion;
+    }
+
+    // Cells `op` reads and writes. `indirect` is the cell mask LDAI/STAI point at.
+    static void Access(const Decode::DecodedOp& op, uint16_t indirect, uint16_t& reads, uint16_t& writes){
+        switch (op.handler)
+        {
+        case Decode::OP_LDA:
+        case Decode::OP_ADD:
+        case Decode::OP_SUB:
+        case Decode::OP_AND:
+        case Decode::OP_OR:
+        case Decode::OP_XOR:
+            reads = Bit(op.operand);
+            break;
+        case Decode::OP_INPUT:
+            writes = Bit(14); // only once the value arrives (see AfterExecute() and InputDelivered())
+            break;
+        case Decode::OP_STA:
+        case Decode::OP_STA_GPIO:
+        case Decode::OP_STA_DEV:
+            writes = Bit(op.operand);
+            break;
+        case Decode::OP_LDA_DEV: // reads the device, then mirrors the value into the cell
+            reads = writes = Bit(op.operand);
+            break;
+        case Decode::OP_LDAI:
+            reads = Bit(op.operand) | indirect;
+            break;
+        case Decode::OP_STAI:
+            reads = Bit(op.operand);
+            writes = indirect;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Run() once the engine stopped at a trapped PC, for whatever reason: `result` is that run.
+    // The trapped instruction goes through the observer, the engine runs up to the next trap,
+    // and so on.
+    CPU4BIT_NOINLINE RunResult RunTrapped(CPU4bit& cpu, uint64_t budget, RunResult result){
+        // Check the PC the way AfterExecute() would have (never at the start of the run).
+        if (result.executed > 0 && CheckPC(cpu)) {
+            result.reason = StopReason::Predicate;
+            return result;
+        }
+        if (result.reason != StopReason::Trap) return result;
+        result.reason = StopReason::Budget;
+        while (result.executed < budget)
+        {
+            RunResult step = cpu.RunHooked(*this, 1);
+            result.executed += step.executed;
+            result.reason = step.reason;
+            if (step.reason != StopReason::Budget || result.executed == budget) break;
+            if (cpu.Trapped(cpu.PC)) continue;
+
+            RunResult fast = cpu.RunFor(budget - result.executed);
+            result.executed += fast.executed;
+            result.reason = fast.reason;
+            // The engine stopped before a trapped instruction or after the last one it ran:
+            // check the PC the way AfterExecute() would have.
+            if ((fast.reason == StopReason::Trap || fast.executed > 0) && CheckPC(cpu)) {
+                result.reason = StopReason::Predicate;
+                break;
+            }
+            if (fast.reason != StopReason::Trap) break;
+            result.reason = StopReason::Budget;
+        }
+        return result;
+    }
+
+    // A PC breakpoint at cpu.PC whose condition holds: records the hit.
+    CPU4BIT_NOINLINE bool CheckPC(const CPU4bit& cpu){
+        if (!HasPC(cpu.PC)) return false;
+        int slot = FindCondition(cpu.PC);
+        if (slot >= 0 && !conditions[slot].Eval(cpu)) return false;
+        hit = { BREAK_PC, cpu.PC };
+        return true;
+    }
+
+    static uint16_t Bit(uint8_t cell){ return (uint16_t)(1u << (cell & 0xF)); }
+
+    static uint8_t LowestCell(uint16_t mask){
+        uint8_t cell = 0;
+        while (!((mask >> cell) & 1)) cell++;
+        return cell;
+    }
+
+    int FindCondition(int addr) const {
+        for (int i = 0; i < MAX_CONDITIONS; ++i) if (conditionAddr[i] == addr) return i;
+        return -1;
+    }
+};
+
+#endif
@@ -2,100 +2,274 @@
 #define CPU_H
 
 #include <vector> // Dynamic Array 
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <cstdint> // Integers with certain sizes
 #include <iostream> // input output stream
 #include <cstdlib> // C standard : mem , translations , ...
 #include <map>
 #include <string>
 #include "Peripherals.h"
+#include "CPUState.h"
+#include "Decoder.h"
+#include "CPUHooks.h"
+#include "InputProvider.h"
+#include "PeripheralBus.h"
+#include "OutputLog.h"
 
-class CPU4bit{
+// Execution engine, picked when the CPU is constructed.
+// Both engines run over the decode cache and produce bit-identical architectural state.
+enum class ExecEngine {
+    Switch,   // indexed switch over the decoded handler id
+    Threaded  // direct-threaded dispatch (GCC/Clang labels-as-values, switch fallback elsewhere)
+};
+
+// Why RunFor()/RunUntil() returned.
+enum class StopReason {
+    Budget,          // executed the requested number of instructions
+    Halted,          // HLT
+    WaitingForInput, // LDA 14 found no input: call ResolveInput() (or PollInput()) before running again
+    Output,          // OUT or a write to the LED port or a device (only when stopOnOutput is set)
+    Predicate,       // the RunUntil() predicate returned true
+    Trap             // PC reached a trapped address (SetTraps); that instruction has not executed
+};
+
+struct RunResult {
+    StopReason reason = StopReason::Budget;
+    uint64_t executed = 0;
+};
+
+// Registers, flags, RAM, STACK, GPIO and console live in the CPUState base (one cache line);
+// CPU4bit adds the program (ROM + decode cache) and the execution engines.
+class CPU4bit : public CPUState {
 private:
-    GPIO_Unit gpio;
+    ExecEngine engine = ExecEngine::Switch;
+    InputProvider* inputProvider = nullptr;
+    PeripheralBus bus;
+    OutputLog* outputLog = nullptr;
+
+    // Set for the duration of RunFor(..., true)/RunUntil(..., true): output instructions end the run
+    bool breakOnOutput = false;
+    bool outputStop = false;
+    bool trapStop = false;
+
+    // What RunSwitch()/RunThreaded() dispatch on: the decode cache with OP_TRAP at every
+    // address set in `traps`.
+    std::array<Decode::DecodedOp, 256> dispatch;
+    std::array<uint64_t, 4> traps = {};
+
+    uint64_t RunSwitch(uint64_t budget);
+    uint64_t RunThreaded(uint64_t budget){
+        NoRecorder none;
+        return RunThreadedOn(dispatch.data(), none, budget);
+    }
+    template <class Recorder>
+    uint64_t RunThreadedOn(const Decode::DecodedOp* table, Recorder& recorder, uint64_t budget);
+
+    // LDA 14: the provider's value if it has one, otherwise stop and wait for the host.
+    void RequestInput(){
+        uint8_t value;
+        if (inputProvider && inputProvider->NextInput(value)) DeliverInput(value);
+        else isWaitingForInput = true;
+    }
+
+    void DeliverInput(int val){
+        ACC = val & 0xF;
+        WriteRAM(14, ACC);
+        Z = (ACC == 0);
+        SetConsoleEvent(CONSOLE_INPUT, (uint8_t)val);
+    }
+
+    Decode::DecodedOp DecodeAddress(uint8_t address) const {
+        return Decode::DecodeAt(ROM.data(), address, bus.ReadMask(), bus.WriteMask());
+    }
+
+    void RebuildDispatch(uint8_t address){
+        if (Trapped(address)) {
+            dispatch[address] = { Decode::OP_TRAP, 0, 0, 1 };
+        } else {
+            dispatch[address] = decoded[address];
+        }
+    }
+
+    void EmitOutput(uint8_t value){
+        console.Push(value);
+        if (outputLog) outputLog->Append(value);
+    }
+
+    static uint64_t NextDispatchVersion(){
+        static std::atomic<uint64_t> next{ 0 };
+        return ++next;
+    }
+
+    StopReason ReasonAfterRun() const {
+        if (halted) return StopReason::Halted;
+        if (isWaitingForInput) return StopReason::WaitingForInput;
+        if (outputStop) return StopReason::Output;
+        if (trapStop) return StopReason::Trap;
+        return StopReason::Budget;
+    }
 
 public:
-    // REGISTERS
-    uint8_t ACC = 0; // Accumulator Register (4 bit)
-    uint8_t PC = 0; // Program Counter Register (8 bit)
-    uint8_t IR = 0; // Instruction Register (8 bit)
-    uint8_t SP = 0 ; // Stack Pointer Register (8 bit)
-    
-    //FLAGS
-    bool Z = false; // Zero Flag
-    bool C = false; // Carry Flag
-
-    //MEMORY (HARVARD)
-    std::vector<uint8_t> ROM; // Program Memmory (256 byte)
-    std::vector<uint8_t> RAM; // Data Memmory (16 nibble)
-    std::vector<uint8_t> STACK; // Stack (16 )
-
-    bool halted = false;
-    bool isWaitingForInput = false;
-
-    std::string consoleBuffer = "System Ready.";
-
-    CPU4bit(){
-        ROM.resize(256,0);
-        RAM.resize(16,0);
-        STACK.resize(16, 0);
+    //PROGRAM MEMORY (HARVARD)
+    std::array<uint8_t, 256> ROM = {}; // Program Memmory (256 byte) - write through WriteROM() so the decode cache stays valid
+
+    // DECODE CACHE (one entry per ROM address, rebuilt whenever ROM changes)
+    std::array<Decode::DecodedOp, 256> decoded;
+    uint32_t romVersion = 0; // bumped on every ROM change so external caches (JIT) can revalidate
+    // Renewed whenever the engines' dispatch table changes (ROM or traps). Versions are unique
+    // across all CPUs, so two CPUs with the same version have the same table (one is a copy).
+    uint64_t dispatchVersion = 0;
+
+    explicit CPU4bit(ExecEngine selectedEngine = ExecEngine::Switch) : engine(selectedEngine) {
+        RebuildDecodeCache();
+    }
+
+    // Snapshot access: the whole machine state except ROM, copyable with a single memcpy
+    CPUState& State() { return *this; }
+    const CPUState& State() const { return *this; }
+
+    // Registers, flags, RAM, STACK, GPIO and console (everything but the program).
+    // Restore() keeps the loaded ROM, so a snapshot only makes sense for the same program.
+    CPUState Snapshot() const { return State(); }
+    void Restore(const CPUState& snapshot){ State() = snapshot; }
+
+    std::string ConsoleText() const { return console.Text(); }
+    void SetConsoleEvent(ConsoleEvent event, uint8_t value = 0){ console.lastEvent = event; console.lastValue = value; }
+
+    void RebuildDecodeCache(){
+        for (int addr = 0; addr < 256; ++addr) {
+            decoded[addr] = DecodeAddress((uint8_t)addr);
+            RebuildDispatch((uint8_t)addr);
+        }
+        romVersion++;
+        dispatchVersion = NextDispatchVersion();
+    }
+
+    void WriteROM(uint8_t address, uint8_t value){
+        ROM[address] = value;
+        // The byte may be an opcode or the target byte of the previous two-byte instruction.
+        uint8_t previous = (uint8_t)(address - 1);
+        decoded[address] = DecodeAddress(address);
+        decoded[previous] = DecodeAddress(previous);
+        RebuildDispatch(address);
+        RebuildDispatch(previous);
+        romVersion++;
+        dispatchVersion = NextDispatchVersion();
     }
 
+    // Addresses where RunFor()/Run() stop before executing (StopReason::Trap), one bit per ROM
+    // address. Step(), RunHooked() and the JIT ignore traps, so a host can single-step the
+    // trapped instruction with its observer and resume the engine (see Breakpoints::Run()).
+    // Only the addresses that change are touched, so installing and removing a few traps
+    // around every run is cheap.
+    void SetTraps(const std::array<uint64_t, 4>& bits){
+        if (bits == traps) return;
+        dispatchVersion = NextDispatchVersion();
+        for (int word = 0; word < 4; ++word)
+        {
+            uint64_t changed = bits[word] ^ traps[word];
+            traps[word] = bits[word];
+            for (int bit = 0; changed != 0; ++bit, changed >>= 1)
+            {
+                if (changed & 1) RebuildDispatch((uint8_t)(word * 64 + bit));
+            }
+        }
+    }
+
+    void ClearTraps(){ SetTraps(std::array<uint64_t, 4>{}); }
+    bool Trapped(uint8_t address) const { return (traps[address >> 6] >> (address & 63)) & 1; }
+
+
     void Reset(){
         PC = 0;SP = 0; ACC = 0;Z = false;C = false;
         halted = false; 
         isWaitingForInput = false;
-        consoleBuffer = "System Reset.";
+        console.lastEvent = CONSOLE_RESET;
         gpio.Reset();
-        std::fill(RAM.begin(), RAM.end(), 0);
+        RAM.fill(0);
     }
 
-    void ResolveInput(uint8_t val) {
-        if (!isWaitingForInput) return;
-        uint8_t safeVal = val & 0xF;
-        
-        ACC = safeVal;    
-        RAM[14] = safeVal;
-        ACC = val & 0xF; 
-        Z = (ACC == 0);  
-        isWaitingForInput = false; 
+    // Source LDA 14 asks before it waits (see InputProvider.h); nullptr = always wait.
+    // Not part of CPUState, so snapshots don't carry it; a copied CPU4bit shares the provider.
+    void SetInputProvider(InputProvider* provider){ inputProvider = provider; }
+    InputProvider* GetInputProvider() const { return inputProvider; }
+
+    // Completes a pending LDA 14 from the provider. Returns false if it has nothing yet.
+    bool PollInput(){
+        uint8_t value;
+        if (!isWaitingForInput || !inputProvider || !inputProvider->NextInput(value)) return false;
+        ResolveInput((int)value);
+        return true;
     }
 
+    // Maps `device` at RAM address `address` (see PeripheralBus.h); nullptr detaches it.
+    // Re-resolves the decode cache, so attach devices before running rather than per step.
+    // Like the input provider, devices are shared by copies of this CPU.
+    bool AttachDevice(uint8_t address, Peripheral* device){
+        if (!bus.Attach(address, device)) return false;
+        RebuildDecodeCache();
+        return true;
+    }
+
+    void DetachDevices(){
+        bus.DetachAll();
+        RebuildDecodeCache();
+    }
+
+    const PeripheralBus& Bus() const { return bus; }
+
+    // Receives every OUT value (see OutputLog.h); nullptr = only the 16-entry console ring.
+    // Cleared by LoadProgram(). Not part of CPUState; a copied CPU4bit shares the log.
+    void SetOutputLog(OutputLog* log){ outputLog = log; }
+    OutputLog* GetOutputLog() const { return outputLog; }
+
     void WriteMemory(uint8_t address, uint8_t value) {
-        if (address == 15) { 
+        if (address < 16 && ((bus.WriteMask() >> address) & 1)) {
+            bus.Write(address, value);
+            WriteRAM(address, value & 0xF);
+        } else if (address == 15) { 
             gpio.WriteOutputPort(value);
-            RAM[15] = value & 0xF;
+            WriteRAM(15, value & 0xF);
         } else {
-            if(address < 16) RAM[address] = value & 0xF;
+            if(address < 16) WriteRAM(address, value & 0xF);
         }
     }
 
     uint8_t ReadMemory(uint8_t address) {
-        if (address < 16) return RAM[address];
+        if (address < 16) return ReadRAM(address);
         return 0;
     }
 
     void LoadProgram(const std::vector<uint8_t>& code , const std::map<int,uint8_t>& data){
-        std::fill(ROM.begin(),ROM.end(),0); 
-        for (size_t i=0;i<code.size();++i){
+        ROM.fill(0);
+        for (size_t i=0;i<code.size() && i<ROM.size();++i){
             ROM[i] = code[i];
         }
+        RebuildDecodeCache();
 
-        std::fill(RAM.begin(),RAM.end(),0);
+        RAM.fill(0);
         for (auto const& [addr,val] : data)
         {
-            if (addr<RAM.size())
+            if (addr >= 0 && addr < (int)RAM.size())
             {
-                RAM[addr] = val & 0xF;
+                WriteRAM((uint8_t)addr, val & 0xF);
             }
         }
         
-        PC = 0; ACC = 0; SP = 0; Z = false; C = false;
+        // Leaves the CPU exactly as a freshly constructed one, so objects can be reused across programs
+        PC = 0; ACC = 0; SP = 0; IR = 0; Z = false; C = false;
         halted = false;
+        isWaitingForInput = false;
+        STACK.fill(0);
+        console.Clear();
+        if (outputLog) outputLog->Clear();
         gpio.Reset();
     }
 
     void SetRAM(int addr, uint8_t val){
-        if (addr >= 0 && addr<16) RAM[addr] = val & 0xF; // Lower Nibble Mask (0000 1111)
+        if (addr >= 0 && addr<16) WriteRAM((uint8_t)addr, val & 0xF); // Lower Nibble Mask (0000 1111)
     }
 
     bool isHalted()const{return halted;}
@@ -125,8 +299,13 @@ public:
         case 0x0: // NOP
             break;
         case 0x1: // LDA[addr]
-            if (operand == 14) { 
-                isWaitingForInput = true; 
+            if ((bus.ReadMask() >> operand) & 1) {
+                ACC = bus.Read(operand);
+                WriteRAM(operand, ACC);
+                Z = (ACC == 0);
+            }
+            else if (operand == 14) { 
+                RequestInput();
                 return; 
             }
             else {
@@ -143,7 +322,7 @@ public:
             break;
         case 0x4: // ADD [addr]
             {
-                uint16_t temp = ACC + RAM[operand];
+                uint16_t temp = ACC + ReadRAM(operand);
                 C = (temp > 15);
                 ACC = temp & 0xF; // Masking
                 Z = (ACC==0);
@@ -151,35 +330,35 @@ public:
             break;
         case 0x5: // SUB [addr]
             {
-                int temp = ACC - RAM[operand];
+                int temp = ACC - ReadRAM(operand);
                 C = (temp<0);
                 ACC = temp & 0xF;
                 Z = (ACC == 0);
             }
             break;
         case 0x6: // AND [addr]
-            ACC = ACC & RAM[operand];
+            ACC = ACC & ReadRAM(operand);
             Z = (ACC == 0);
             break;
         case 0x7: // OR [addr]
-            ACC = ACC | RAM[operand];
+            ACC = ACC | ReadRAM(operand);
             Z = (ACC == 0);
             break;
         case 0x8: // XOR [addr]
-            ACC = ACC ^ RAM[operand];
+            ACC = ACC ^ ReadRAM(operand);
             Z = (ACC == 0);
             break;
         case 0x9: // LDAI [operand]
             {
-                uint8_t targetAddr = RAM[operand] & 0xF;
-                ACC = RAM[targetAddr];
+                uint8_t targetAddr = ReadRAM(operand) & 0xF;
+                ACC = ReadRAM(targetAddr);
                 Z = (ACC==0);
             }
             break;
         case 0xA:
             {
-                uint8_t targetAddr = RAM[operand] & 0xF;
-                RAM[targetAddr] = ACC;
+                uint8_t targetAddr = ReadRAM(operand) & 0xF;
+                WriteRAM(targetAddr, ACC);
             }
             break;
         case 0xB: // JMP
@@ -211,7 +390,7 @@ public:
                 Reset();gpio.Reset();
                 break;
             case 0x2: // OUT
-                consoleBuffer = ">>> OUTPUT: " + std::to_string((int)ACC);
+                EmitOutput(ACC);
                 break;
             case 0x3: // NOT
                 ACC = (~ACC) & 0xF;
@@ -246,18 +425,241 @@ public:
         }
     }
 
+    // Fetch + Execute through the decode cache: one indexed dispatch per instruction.
+    // Produces exactly the same state as Fetch(); Execute();
+    void Step(){
+        if(halted || isWaitingForInput) return;
+
+        const Decode::DecodedOp op = decoded[PC];
+        IR = ROM[PC];
+        PC++;
+        ExecuteDecoded(op);
+    }
+
+    // Fused Fetch/Execute loop. Runs up to `budget` instructions and only returns on
+    // HLT, an input request (LDA 14), budget exhaustion, a trapped address or (inside
+    // RunFor/RunUntil with stopOnOutput) an output instruction. Returns the number executed.
+    uint64_t Run(uint64_t budget){
+        trapStop = false;
+        if(halted || isWaitingForInput) return 0;
+        return (engine == ExecEngine::Threaded) ? RunThreaded(budget) : RunSwitch(budget);
+    }
+
+    // Runs up to `budget` instructions inside the engine loop and reports why it stopped.
+    // A zero budget, or a CPU that is already halted/waiting, executes nothing.
+    RunResult RunFor(uint64_t budget, bool stopOnOutput = false){
+        RunResult result;
+        breakOnOutput = stopOnOutput;
+        outputStop = false;
+        result.executed = Run(budget);
+        breakOnOutput = false;
+        result.reason = ReasonAfterRun();
+        return result;
+    }
+
+    // RunFor() over the decoded step loop with an observer (see CPUHooks.h) called around
+    // every instruction. The hook calls are resolved at compile time and inlined.
+    template <class Hooks>
+    RunResult RunHooked(Hooks& hooks, uint64_t budget = UINT64_MAX, bool stopOnOutput = false){
+        RunResult result;
+        breakOnOutput = stopOnOutput;
+        outputStop = false;
+        trapStop = false;
+        while (!halted && !isWaitingForInput && !outputStop && result.executed < budget)
+        {
+            const Decode::DecodedOp op = decoded[PC];
+            hooks.BeforeExecute(static_cast<const CPU4bit&>(*this), op);
+            IR = ROM[PC];
+            PC++;
+            ExecuteDecoded(op);
+            result.executed++;
+            if (hooks.AfterExecute(static_cast<const CPU4bit&>(*this))) {
+                breakOnOutput = false;
+                result.reason = StopReason::Predicate;
+                return result;
+            }
+        }
+        breakOnOutput = false;
+        result.reason = ReasonAfterRun();
+        return result;
+    }
+
+    // RunFor() on the threaded engine (whatever the CPU's engine setting) with `recorder` (see
+    // CPUHooks.h) told about every instruction before it runs. Like RunHooked() it ignores
+    // traps; it costs a fraction of RunHooked() for observers that fit the recorder interface.
+    template <class Recorder>
+    RunResult RunRecorded(Recorder& recorder, uint64_t budget = UINT64_MAX){
+        RunResult result;
+        outputStop = false;
+        trapStop = false;
+        if (!halted && !isWaitingForInput) result.executed = RunThreadedOn(decoded.data(), recorder, budget);
+        result.reason = ReasonAfterRun();
+        return result;
+    }
+
+    // Like RunFor(), and additionally stops after the first instruction for which
+    // `stop(const CPU4bit&)` returns true. The predicate is inlined into the step loop.
+    template <class Predicate>
+    RunResult RunUntil(Predicate stop, uint64_t budget = UINT64_MAX, bool stopOnOutput = false){
+        struct PredicateHooks : NoHooks {
+            Predicate& stop;
+            explicit PredicateHooks(Predicate& p) : stop(p) {}
+            bool AfterExecute(const CPU4bit& cpu){ return stop(cpu); }
+        } hooks(stop);
+        return RunHooked(hooks, budget, stopOnOutput);
+    }
+
+    ExecEngine getEngine() const { return engine; }
+
+    // Execute stage for an already fetched, pre-decoded instruction (PC points past the opcode byte).
+    void ExecuteDecoded(const Decode::DecodedOp& op){
+        switch (op.handler)
+        {
+        case Decode::OP_NOP:
+            break;
+        case Decode::OP_LDA:
+            ACC = ReadRAM(op.operand);
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_INPUT:
+            RequestInput();
+            break;
+        case Decode::OP_LDI:
+            ACC = op.operand;
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_STA:
+            WriteRAM(op.operand, ACC & 0xF);
+            break;
+        case Decode::OP_STA_GPIO:
+            gpio.WriteOutputPort(ACC);
+            WriteRAM(15, ACC & 0xF);
+            outputStop = breakOnOutput;
+            break;
+        case Decode::OP_ADD:
+            {
+                uint16_t temp = ACC + ReadRAM(op.operand);
+                C = (temp > 15);
+                ACC = temp & 0xF;
+                Z = (ACC == 0);
+            }
+            break;
+        case Decode::OP_SUB:
+            {
+                int temp = ACC - ReadRAM(op.operand);
+                C = (temp < 0);
+                ACC = temp & 0xF;
+                Z = (ACC == 0);
+            }
+            break;
+        case Decode::OP_AND:
+            ACC = ACC & ReadRAM(op.operand);
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_OR:
+            ACC = ACC | ReadRAM(op.operand);
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_XOR:
+            ACC = ACC ^ ReadRAM(op.operand);
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_LDAI:
+            ACC = ReadRAM(ReadRAM(op.operand) & 0xF);
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_STAI:
+            WriteRAM(ReadRAM(op.operand) & 0xF, ACC);
+            break;
+        case Decode::OP_JMP:
+            PC = op.target;
+            break;
+        case Decode::OP_JZ:
+            PC = Z ? op.target : (uint8_t)(PC + 1);
+            break;
+        case Decode::OP_JC:
+            PC = C ? op.target : (uint8_t)(PC + 1);
+            break;
+        case Decode::OP_CALL:
+            if (SP < STACK.size())
+            {
+                STACK[SP] = PC + 1;
+                SP++;
+            }
+            PC = op.target;
+            break;
+        case Decode::OP_HLT:
+            halted = true;
+            break;
+        case Decode::OP_RST:
+            Reset();
+            break;
+        case Decode::OP_OUT:
+            EmitOutput(ACC);
+            outputStop = breakOnOutput;
+            break;
+        case Decode::OP_NOT:
+            ACC = (~ACC) & 0xF;
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_PUSH:
+            if (SP < STACK.size()) {
+                STACK[SP] = ACC;
+                SP++;
+            }
+            break;
+        case Decode::OP_POP:
+            if (SP > 0) {
+                SP--;
+                ACC = STACK[SP];
+            }
+            break;
+        case Decode::OP_RET:
+            if (SP > 0) {
+                SP--;
+                PC = STACK[SP];
+            }
+            break;
+        case Decode::OP_LDA_DEV:
+            ACC = bus.Read(op.operand);
+            WriteRAM(op.operand, ACC);
+            Z = (ACC == 0);
+            break;
+        case Decode::OP_STA_DEV:
+            bus.Write(op.operand, ACC);
+            WriteRAM(op.operand, ACC & 0xF);
+            outputStop = breakOnOutput;
+            break;
+        case Decode::OP_TRAP: // only in the dispatch table; RunSwitch() stops before it
+            break;
+        }
+    }
+
     void ResolveInput(int val) {
         if (!isWaitingForInput) return;
-
-        ACC = val & 0xF; 
-        RAM[14] = ACC;   
-        Z = (ACC == 0); 
-        
+        DeliverInput(val);
         isWaitingForInput = false; 
-        consoleBuffer = "Input Received: " + std::to_string(val);
     }
 
     GPIO_Unit& getGPIO() { return gpio; }
+    const GPIO_Unit& getGPIO() const { return gpio; }
 };
 
+inline uint64_t CPU4bit::RunSwitch(uint64_t budget){
+    uint64_t executed = 0;
+    while (executed < budget)
+    {
+        const Decode::DecodedOp op = dispatch[PC];
+        if (op.handler == Decode::OP_TRAP) { trapStop = true; break; }
+        IR = ROM[PC];
+        PC++;
+        ExecuteDecoded(op);
+        executed++;
+        if (halted || isWaitingForInput || outputStop) break;
+    }
+    return executed;
+}
+
+#include "ThreadedEngine.h"
+
 #endif
\ No newline at end of file
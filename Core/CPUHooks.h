@@ -0,0 +1,49 @@
+#ifndef CPU_HOOKS_H
+#define CPU_HOOKS_H
+
+// Observer policy for CPU4bit::RunHooked(). A hooks type provides the members below; deriving
+// from NoHooks supplies empty defaults, which inline away, so a run with NoHooks costs the same
+// as the plain step loop. Hooks see the CPU as const: they observe, the CPU executes.
+
+#include "Decoder.h"
+
+class CPU4bit;
+
+struct NoHooks {
+    // Before `op` (the decoded instruction at PC) executes; nothing has changed yet.
+    void BeforeExecute(const CPU4bit&, const Decode::DecodedOp&) {}
+    // After it executed. Returning true ends the run with StopReason::Predicate.
+    bool AfterExecute(const CPU4bit&) { return false; }
+};
+
+// Runs two observers side by side; the run stops if either asks to.
+template <class First, class Second>
+struct HookPair {
+    First& first;
+    Second& second;
+
+    HookPair(First& a, Second& b) : first(a), second(b) {}
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        first.BeforeExecute(cpu, op);
+        second.BeforeExecute(cpu, op);
+    }
+
+    bool AfterExecute(const CPU4bit& cpu){
+        bool stopFirst = first.AfterExecute(cpu);
+        bool stopSecond = second.AfterExecute(cpu);
+        return stopFirst || stopSecond;
+    }
+};
+
+// Recorder policy for CPU4bit::RunRecorded(). The threaded engine keeps the registers in
+// locals, so instead of the CPU it hands a recorder the values an observer usually reads:
+// the instruction, pc, acc and sp before it runs, and `read(cell)` for the current RAM.
+// Recorders cannot stop the run. The engine works on a copy of the recorder and writes it back
+// when the run ends, so a recorder should be a few words of state (TraceWriter::Recorder).
+struct NoRecorder {
+    template <class ReadRAM>
+    void Record(const Decode::DecodedOp&, uint8_t, uint8_t, uint8_t, ReadRAM) {}
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef CPU_STATE_H
+#define CPU_STATE_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "Peripherals.h"
+
+// Console messages are stored as an event code plus raw bytes and only turned into text
+// when someone asks for it (ConsoleText), so OUT/RST/input never allocate.
+enum ConsoleEvent : uint8_t {
+    CONSOLE_READY = 0,    // "System Ready."
+    CONSOLE_RESET,        // "System Reset."
+    CONSOLE_OUTPUT,       // ">>> OUTPUT: <last OUT value>"
+    CONSOLE_INPUT,        // "Input Received: <value>"
+    CONSOLE_COMPILED      // "Compilation Successful."
+};
+
+// Fixed ring of the most recent OUT values (raw bytes, oldest overwritten first).
+struct ConsoleRing {
+    static const int CAPACITY = 16;
+
+    uint8_t bytes[CAPACITY] = {};
+    uint8_t head = 0;      // next write position
+    uint8_t count = 0;     // valid entries (<= CAPACITY)
+    uint8_t lastEvent = CONSOLE_READY;
+    uint8_t lastValue = 0; // value shown with CONSOLE_INPUT
+
+    void Push(uint8_t value){
+        bytes[head] = value;
+        head = (uint8_t)((head + 1) % CAPACITY);
+        if (count < CAPACITY) count++;
+        lastEvent = CONSOLE_OUTPUT;
+    }
+
+    void Clear(){ head = 0; count = 0; lastEvent = CONSOLE_READY; lastValue = 0; }
+
+    // i = 0 is the oldest value still in the ring
+    uint8_t At(int i) const { return bytes[(head + CAPACITY - count + i) % CAPACITY]; }
+    uint8_t Last() const { return count ? At(count - 1) : 0; }
+
+    std::string Text() const {
+        switch (lastEvent)
+        {
+        case CONSOLE_RESET:    return "System Reset.";
+        case CONSOLE_OUTPUT:   return ">>> OUTPUT: " + std::to_string((int)Last());
+        case CONSOLE_INPUT:    return "Input Received: " + std::to_string((int)lastValue);
+        case CONSOLE_COMPILED: return "Compilation Successful.";
+        default:               return "System Ready.";
+        }
+    }
+};
+
+// Branch-free access to 16 nibbles packed into one 64-bit word (cell i = bits 4i..4i+3).
+// The index is masked, so every address is in range and no bounds check is needed.
+namespace Nibble {
+    inline uint8_t Get(uint64_t word, unsigned index){
+        return (uint8_t)((word >> ((index & 0xF) * 4)) & 0xF);
+    }
+
+    inline uint64_t Set(uint64_t word, unsigned index, uint8_t value){
+        unsigned shift = (index & 0xF) * 4;
+        return (word & ~(0xFULL << shift)) | ((uint64_t)(value & 0xF) << shift);
+    }
+}
+
+// Data memory as one uint64_t. Exposes the subset of std::array used around the code base
+// (operator[], size, fill, ==) so UI and tools read it the same way in both layouts.
+struct PackedRAM {
+    uint64_t bits = 0;
+
+    struct CellRef {
+        uint64_t& word;
+        unsigned index;
+        operator uint8_t() const { return Nibble::Get(word, index); }
+        CellRef& operator=(uint8_t value){ word = Nibble::Set(word, index, value); return *this; }
+    };
+
+    uint8_t operator[](size_t i) const { return Nibble::Get(bits, (unsigned)i); }
+    CellRef operator[](size_t i){ return CellRef{ bits, (unsigned)i }; }
+    static constexpr size_t size(){ return 16; }
+    void fill(uint8_t value){ bits = (value & 0xF) * 0x1111111111111111ULL; }
+    bool operator==(const PackedRAM& other) const { return bits == other.bits; }
+    bool operator!=(const PackedRAM& other) const { return bits != other.bits; }
+};
+
+// Build with -DCPU4BIT_PACKED_RAM to keep RAM nibble-packed. Every cell is then truncated to
+// 4 bits, including the values STAI stores (the byte layout keeps them unmasked).
+#ifdef CPU4BIT_PACKED_RAM
+typedef PackedRAM RamBank;
+#else
+typedef std::array<uint8_t, 16> RamBank;
+#endif
+
+// Complete architectural state of the CPU except ROM: registers and flags share the first
+// 8-byte word, followed by RAM, STACK, GPIO and the console ring.
+// Trivially copyable and exactly one cache line, so a snapshot is a single 64-byte memcpy.
+struct alignas(64) CPUState {
+    // REGISTERS
+    uint8_t ACC = 0; // Accumulator Register (4 bit)
+    uint8_t PC = 0; // Program Counter Register (8 bit)
+    uint8_t IR = 0; // Instruction Register (8 bit)
+    uint8_t SP = 0 ; // Stack Pointer Register (8 bit)
+
+    //FLAGS
+    bool Z = false; // Zero Flag
+    bool C = false; // Carry Flag
+    bool halted = false;
+    bool isWaitingForInput = false;
+
+    //DATA MEMORY
+    RamBank RAM = {}; // Data Memmory (16 nibble) - see CPU4BIT_PACKED_RAM
+    std::array<uint8_t, 16> STACK = {}; // Stack (16 )
+
+    GPIO_Unit gpio;
+    ConsoleRing console;
+
+#ifdef CPU4BIT_PACKED_RAM
+    uint8_t ReadRAM(uint8_t addr) const { return Nibble::Get(RAM.bits, addr); }
+    void WriteRAM(uint8_t addr, uint8_t value){ RAM.bits = Nibble::Set(RAM.bits, addr, value); }
+    // Whole data memory as one word: hashing, comparing and snapshotting RAM is one register op
+    uint64_t RAMWord() const { return RAM.bits; }
+    void CopyRAMTo(uint8_t* out) const { for (unsigned i = 0; i < 16; ++i) out[i] = Nibble::Get(RAM.bits, i); }
+    void CopyRAMFrom(const uint8_t* in){ RAM.bits = 0; for (unsigned i = 0; i < 16; ++i) RAM.bits = Nibble::Set(RAM.bits, i, in[i]); }
+#else
+    uint8_t ReadRAM(uint8_t addr) const { return RAM[addr & 0xF]; }
+    void WriteRAM(uint8_t addr, uint8_t value){ RAM[addr & 0xF] = value; }
+    uint64_t RAMWord() const { // low nibble of each cell
+        uint64_t word = 0;
+        for (unsigned i = 0; i < 16; ++i) word = Nibble::Set(word, i, RAM[i]);
+        return word;
+    }
+    void CopyRAMTo(uint8_t* out) const { std::memcpy(out, RAM.data(), 16); }
+    void CopyRAMFrom(const uint8_t* in){ std::memcpy(RAM.data(), in, 16); }
+#endif
+};
+
+static_assert(std::is_trivially_copyable<CPUState>::value, "CPUState must stay memcpy-able");
+static_assert(sizeof(CPUState) == 64, "CPUState is meant to fill exactly one cache line");
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef CALL_TRACE_H
+#define CALL_TRACE_H
+
+// Call-stack export in the Chrome Trace Event format (chrome://tracing, ui.perfetto.dev).
+//
+// Every CALL that pushes a return address opens a slice named after the assembler label of
+// its target ("sub_0x1A" if there is none), the matching RET closes it, and the whole run is
+// one root slice named after the entry label. Timestamps count executed instructions
+// (1 instruction = 1 "us" in the viewer).
+//
+// Events are written as they happen through a small buffer, in the JSON array form whose
+// closing bracket is optional, so a trace cut short by a crash still loads. Slices follow
+// CALL/RET only: a RET that returns through a PUSHed address closes the innermost slice.
+//
+// Use as a RunHooked() observer; only CALL, RET and RST do any work.
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include "CPU.h"
+
+class CallTraceWriter : public NoHooks {
+public:
+    static const size_t FLUSH_AT = 1 << 16;
+
+    CallTraceWriter() = default;
+    ~CallTraceWriter(){ if (file) std::fclose(file); }
+    CallTraceWriter(const CallTraceWriter&) = delete;
+    CallTraceWriter& operator=(const CallTraceWriter&) = delete;
+
+    // Creates `path` and opens the root slice at the current PC of `cpu`.
+    // `labels` maps ROM addresses to names (Executable::codeLabels).
+    bool Open(const std::string& path, const CPU4bit& cpu, const std::map<int, std::string>& labels,
+              const std::string& processName){
+        if (file) std::fclose(file);
+        file = std::fopen(path.c_str(), "wb");
+        failed = (file == nullptr);
+        if (failed) return false;
+
+        for (int addr = 0; addr < 256; ++addr)
+        {
+            auto it = labels.find(addr);
+            if (it != labels.end()) {
+                names[addr] = Escape(it->second);
+            } else {
+                char buf[16];
+                std::snprintf(buf, sizeof(buf), "sub_0x%02X", addr);
+                names[addr] = buf;
+            }
+        }
+        auto entry = labels.find(cpu.PC);
+        rootName = (entry != labels.end()) ? names[cpu.PC] : "main";
+
+        out = "[\n";
+        first = true;
+        count = calls = 0;
+        depth = maxDepth = 0;
+        Metadata("process_name", Escape(processName));
+        Metadata("thread_name", "CPU4bit");
+        Event('B', rootName, count, cpu.PC, -1);
+        return true;
+    }
+
+    // Closes every open slice and the root slice, finishes the array and closes the file.
+    bool Close(const CPU4bit& cpu){
+        if (!file) return false;
+        CloseAll(cpu.PC);
+        Event('E', rootName, count, cpu.PC, -1);
+        out += "\n]\n";
+        Flush();
+        bool ok = (std::fclose(file) == 0) && !failed;
+        file = nullptr;
+        return ok;
+    }
+
+    uint64_t Calls() const { return calls; }
+    int MaxDepth() const { return maxDepth; }
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        switch (op.handler)
+        {
+        case Decode::OP_CALL:
+            if (cpu.SP < cpu.STACK.size()) {
+                Event('B', names[op.target], count, op.target, cpu.PC);
+                calls++;
+                if (++depth > maxDepth) maxDepth = depth;
+            }
+            break;
+        case Decode::OP_RET:
+            if (cpu.SP > 0 && depth > 0) {
+                Event('E', "", count + 1, cpu.STACK[cpu.SP - 1], -1); // RET is part of the slice
+                depth--;
+            }
+            break;
+        case Decode::OP_RST:
+            CloseAll(cpu.PC); // Reset() empties the return stack
+            break;
+        default:
+            break;
+        }
+        count++;
+    }
+
+private:
+    std::FILE* file = nullptr;
+    std::string out;
+    std::array<std::string, 256> names;
+    std::string rootName;
+    uint64_t count = 0;
+    uint64_t calls = 0;
+    int depth = 0;
+    int maxDepth = 0;
+    bool first = true;
+    bool failed = false;
+
+    static std::string Escape(const std::string& text){
+        std::string s;
+        for (char ch : text)
+        {
+            if (ch == '"' || ch == '\\') s += '\\';
+            if ((unsigned char)ch < 0x20) continue;
+            s += ch;
+        }
+        return s;
+    }
+
+    void Separator(){
+        if (!first) out += ",\n";
+        first = false;
+    }
+
+    void Metadata(const char* kind, const std::string& name){
+        Separator();
+        out += "{\"name\":\"";
+        out += kind;
+        out += "\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"" + name + "\"}}";
+    }
+
+    // `from` is the address of the CALL (-1: not a call); `pc` is the target or return address.
+    void Event(char phase, const std::string& name, uint64_t ts, int pc, int from){
+        Separator();
+        char buf[96];
+        if (phase == 'B') {
+            out += "{\"name\":\"" + name + "\",";
+            if (from >= 0) std::snprintf(buf, sizeof(buf), "\"ph\":\"B\",\"ts\":%llu,\"pid\":1,\"tid\":1,\"args\":{\"pc\":%d,\"from\":%d}}",
+                                         (unsigned long long)ts, pc, from);
+            else std::snprintf(buf, sizeof(buf), "\"ph\":\"B\",\"ts\":%llu,\"pid\":1,\"tid\":1,\"args\":{\"pc\":%d}}",
+                               (unsigned long long)ts, pc);
+        } else {
+            std::snprintf(buf, sizeof(buf), "{\"ph\":\"E\",\"ts\":%llu,\"pid\":1,\"tid\":1,\"args\":{\"pc\":%d}}",
+                          (unsigned long long)ts, pc);
+        }
+        out += buf;
+        if (out.size() >= FLUSH_AT) Flush();
+    }
+
+    void CloseAll(int pc){
+        for (; depth > 0; --depth) Event('E', "", count, pc, -1);
+    }
+
+    void Flush(){
+        if (std::fwrite(out.data(), 1, out.size(), file) != out.size()) failed = true;
+        out.clear();
+    }
+};
+
+#endif
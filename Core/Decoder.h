@@ -0,0 +1,98 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <cstdint>
+
+// Pre-decoded instruction stream.
+// Every ROM address is decoded once (in LoadProgram) into a handler id, operand,
+// resolved jump target and length, so the hot loop does a single indexed dispatch
+// instead of re-extracting opcode/operand and walking the 0xF sub-switch.
+
+namespace Decode {
+
+    enum Handler : uint8_t {
+        OP_NOP = 0,
+        OP_LDA,      // LDA [addr]
+        OP_INPUT,    // LDA 14 (waits for input)
+        OP_LDI,
+        OP_STA,      // STA [addr]
+        OP_STA_GPIO, // STA 15 (drives the LEDs)
+        OP_ADD,
+        OP_SUB,
+        OP_AND,
+        OP_OR,
+        OP_XOR,
+        OP_LDAI,
+        OP_STAI,
+        OP_JMP,
+        OP_JZ,
+        OP_JC,
+        OP_CALL,
+        OP_HLT,
+        OP_RST,
+        OP_OUT,
+        OP_NOT,
+        OP_PUSH,
+        OP_POP,
+        OP_RET,
+        OP_LDA_DEV,  // LDA [addr] with a device mapped for reads (see PeripheralBus.h)
+        OP_STA_DEV,  // STA [addr] with a device mapped for writes
+        OP_TRAP,     // never decoded: CPU4bit::SetTraps() puts it in the engine dispatch table
+        OP_COUNT
+    };
+
+    struct DecodedOp {
+        uint8_t handler; // Handler
+        uint8_t operand; // low nibble of the instruction byte
+        uint8_t target;  // jump target (second byte) for JMP/JZ/JC/CALL
+        uint8_t length;  // 1 or 2 bytes
+    };
+
+    // deviceReads/deviceWrites: one bit per RAM address with a device attached (PeripheralBus).
+    inline DecodedOp DecodeAt(const uint8_t* rom, uint8_t addr, uint16_t deviceReads = 0, uint16_t deviceWrites = 0){
+        uint8_t byte = rom[addr];
+        uint8_t opcode = (byte & 0xF0) >> 4;
+        uint8_t operand = (byte & 0x0F);
+
+        DecodedOp op = { OP_NOP, operand, 0, 1 };
+        switch (opcode)
+        {
+        case 0x0: op.handler = OP_NOP; break;
+        case 0x1: op.handler = ((deviceReads >> operand) & 1) ? OP_LDA_DEV : (operand == 14) ? OP_INPUT : OP_LDA; break;
+        case 0x2: op.handler = OP_LDI; break;
+        case 0x3: op.handler = ((deviceWrites >> operand) & 1) ? OP_STA_DEV : (operand == 15) ? OP_STA_GPIO : OP_STA; break;
+        case 0x4: op.handler = OP_ADD; break;
+        case 0x5: op.handler = OP_SUB; break;
+        case 0x6: op.handler = OP_AND; break;
+        case 0x7: op.handler = OP_OR; break;
+        case 0x8: op.handler = OP_XOR; break;
+        case 0x9: op.handler = OP_LDAI; break;
+        case 0xA: op.handler = OP_STAI; break;
+        case 0xB: op.handler = OP_JMP; break;
+        case 0xC: op.handler = OP_JZ; break;
+        case 0xD: op.handler = OP_JC; break;
+        case 0xE: op.handler = OP_CALL; break;
+        case 0xF:
+            switch (operand)
+            {
+            case 0x0: op.handler = OP_HLT; break;
+            case 0x1: op.handler = OP_RST; break;
+            case 0x2: op.handler = OP_OUT; break;
+            case 0x3: op.handler = OP_NOT; break;
+            case 0x4: op.handler = OP_PUSH; break;
+            case 0x5: op.handler = OP_POP; break;
+            case 0x6: op.handler = OP_RET; break;
+            default:  op.handler = OP_NOP; break; // unused sub-codes behave as NOP
+            }
+            break;
+        }
+
+        if (opcode >= 0xB && opcode <= 0xE) { // JMP, JZ, JC, CALL
+            op.target = rom[(uint8_t)(addr + 1)];
+            op.length = 2;
+        }
+        return op;
+    }
+}
+
+#endif
@@ -0,0 +1,640 @@
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+// GDB remote serial protocol (RSP) server for CPU4bit.
+//
+// GdbConnection listens on 127.0.0.1:<port> or a Unix socket and does the packet framing;
+// GdbStub answers the packets. The CPU is a Harvard machine, so its memories are mapped into
+// one debugger address space (the same trick avr-gdb uses):
+//   0x000000-0x0000FF  ROM (writes go through WriteROM, so the decode cache stays valid)
+//   0x800000-0x80000F  RAM cells (writes are masked to a nibble)
+//   0x810000-0x81000F  return/data stack slots
+// Registers ('g' order, one byte each): acc, pc, sp, ir, z, c. The layout is also served as
+// target.xml and the memory map through qXfer.
+//
+// Breakpoints (Z0/Z1) and watchpoints (Z2 write, Z3 read, Z4 access) live in a Breakpoints
+// set instead of patched ROM. 'c' runs the interpreter in slices of SLICE instructions:
+// cpu.RunFor() while nothing is set, breakpoints.Run() otherwise (the same engine, with the
+// set's addresses installed as traps), and only looks at the socket for a Ctrl-C between
+// slices, so continue runs at full interpreter speed either way.
+// LDA 14 takes values queued with --input or "monitor input N" from the stub's FIFO input
+// provider inside the run loop; with none left the stub stops and says so on the console.
+//
+// Monitor commands: "input N[,N...]", "reset", "status".
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CPU.h"
+#include "Breakpoints.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CPU4BIT_GDB_SOCKETS 1
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define CPU4BIT_GDB_SOCKETS 0
+#endif
+
+namespace GdbLayout {
+    static const uint32_t ROM_BASE = 0x000000;
+    static const uint32_t RAM_BASE = 0x800000;
+    static const uint32_t STACK_BASE = 0x810000;
+    static const int REGISTERS = 6; // acc, pc, sp, ir, z, c
+}
+
+// One debugger session over a socket. Packets are "$data#checksum"; a lone 0x03 byte is an
+// interrupt request.
+class GdbConnection {
+public:
+    GdbConnection() = default;
+    ~GdbConnection(){ Close(); }
+    GdbConnection(const GdbConnection&) = delete;
+    GdbConnection& operator=(const GdbConnection&) = delete;
+
+    bool ListenTCP(int port, std::string& error){
+#if CPU4BIT_GDB_SOCKETS
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0) { error = "cannot create socket"; return false; }
+        int yes = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // never reachable from other hosts
+        return Bind((const sockaddr*)&addr, sizeof(addr), "127.0.0.1:" + std::to_string(port), error);
+#else
+        (void)port;
+        error = "sockets are not supported on this platform";
+        return false;
+#endif
+    }
+
+    bool ListenUnix(const std::string& path, std::string& error){
+#if CPU4BIT_GDB_SOCKETS
+        sockaddr_un addr = {};
+        if (path.size() >= sizeof(addr.sun_path)) { error = "socket path too long"; return false; }
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) { error = "cannot create socket"; return false; }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        ::unlink(path.c_str());
+        unixPath = path;
+        return Bind((const sockaddr*)&addr, sizeof(addr), path, error);
+#else
+        (void)path;
+        error = "sockets are not supported on this platform";
+        return false;
+#endif
+    }
+
+    // Blocks until a debugger connects.
+    bool Accept(){
+#if CPU4BIT_GDB_SOCKETS
+        client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) return false;
+        int yes = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)); // fails harmlessly on Unix sockets
+        ackMode = true;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Close(){
+#if CPU4BIT_GDB_SOCKETS
+        if (client >= 0) ::close(client);
+        if (listener >= 0) ::close(listener);
+        if (!unixPath.empty()) ::unlink(unixPath.c_str());
+#endif
+        client = listener = -1;
+        unixPath.clear();
+    }
+
+    // Next packet payload; false when the debugger went away. An interrupt byte outside a
+    // packet is returned as the pseudo-packet "\x03".
+    bool ReadPacket(std::string& packet){
+        while (true)
+        {
+            int ch = ReadByte(-1);
+            if (ch < 0) return false;
+            if (ch == 0x03) { packet = "\x03"; return true; }
+            if (ch != '$') continue; // acks and noise
+            packet.clear();
+            uint8_t sum = 0;
+            while ((ch = ReadByte(-1)) >= 0 && ch != '#') { packet += (char)ch; sum = (uint8_t)(sum + ch); }
+            int hi = ReadByte(-1), lo = ReadByte(-1);
+            if (ch < 0 || hi < 0 || lo < 0) return false;
+            if (!ackMode) return true;
+            bool ok = (HexValue((char)hi) << 4 | HexValue((char)lo)) == sum;
+            if (!Send(ok ? "+" : "-")) return false;
+            if (ok) return true;
+        }
+    }
+
+    bool SendPacket(const std::string& payload){
+        uint8_t sum = 0;
+        for (char ch : payload) sum = (uint8_t)(sum + (uint8_t)ch);
+        static const char digits[] = "0123456789abcdef";
+        std::string frame = "$" + payload + "#" + digits[sum >> 4] + digits[sum & 0xF];
+        if (!Send(frame)) return false;
+        if (!ackMode) return true;
+        int ch;
+        while ((ch = ReadByte(-1)) >= 0 && ch != '+')
+        {
+            if (ch == '-' && !Send(frame)) return false;
+        }
+        return ch == '+';
+    }
+
+    // Polled between run slices: true if the debugger asked to stop (Ctrl-C) or went away.
+    bool InterruptRequested(){
+        int ch;
+        while ((ch = ReadByte(0)) != TIMEOUT)
+        {
+            if (ch == 0x03 || ch < 0) return true;
+        }
+        return false;
+    }
+
+    void SetAckMode(bool on){ ackMode = on; }
+
+private:
+    static const int TIMEOUT = -2;
+
+    int listener = -1;
+    int client = -1;
+    std::string unixPath;
+    bool ackMode = true;
+    uint8_t buffer[4096];
+    size_t bufferUsed = 0;
+    size_t bufferPos = 0;
+
+#if CPU4BIT_GDB_SOCKETS
+    bool Bind(const sockaddr* addr, socklen_t size, const std::string& name, std::string& error){
+        if (::bind(listener, addr, size) != 0 || ::listen(listener, 1) != 0) {
+            error = "cannot listen on " + name;
+            Close();
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    // Byte from the client; -1 on EOF/error, TIMEOUT if nothing arrived within `timeoutMs`.
+    int ReadByte(int timeoutMs){
+        if (bufferPos < bufferUsed) return buffer[bufferPos++];
+#if CPU4BIT_GDB_SOCKETS
+        if (client < 0) return -1;
+        if (timeoutMs >= 0) {
+            pollfd p = { client, POLLIN, 0 };
+            int ready = ::poll(&p, 1, timeoutMs);
+            if (ready == 0) return TIMEOUT;
+            if (ready < 0) return -1;
+        }
+        ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) return -1;
+        bufferUsed = (size_t)n;
+        bufferPos = 1;
+        return buffer[0];
+#else
+        (void)timeoutMs;
+        return -1;
+#endif
+    }
+
+    bool Send(const std::string& data){
+#if CPU4BIT_GDB_SOCKETS
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = ::send(client, data.data() + sent, data.size() - sent, 0);
+            if (n <= 0) return false;
+            sent += (size_t)n;
+        }
+        return true;
+#else
+        (void)data;
+        return false;
+#endif
+    }
+
+public:
+    static int HexValue(char ch){
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+        return -1;
+    }
+};
+
+class GdbStub {
+public:
+    static const uint64_t SLICE = 1 << 20; // instructions between interrupt checks
+
+    // `cpu` must already hold the program; its current state is what "reset" returns to.
+    explicit GdbStub(CPU4bit& target) : cpu(target), initial(target.Snapshot()) { cpu.SetInputProvider(&input); }
+    ~GdbStub(){ cpu.SetInputProvider(nullptr); }
+    GdbStub(const GdbStub&) = delete;
+    GdbStub& operator=(const GdbStub&) = delete;
+
+    void QueueInputs(const std::vector<uint8_t>& values){ input.Push(values); }
+    uint64_t Executed() const { return executed; }
+
+    // Serves one debugger session; returns when it detaches, kills the target or disconnects.
+    void Serve(GdbConnection& connection){
+        link = &connection;
+        std::string packet;
+        while (!done && connection.ReadPacket(packet))
+        {
+            std::string reply;
+            if (!Handle(packet, reply)) continue; // no reply expected
+            if (!connection.SendPacket(reply)) break;
+            if (packet == "QStartNoAckMode") connection.SetAckMode(false);
+        }
+        link = nullptr;
+    }
+
+    // Answers one packet payload. Returns false for packets that take no reply.
+    bool Handle(const std::string& packet, std::string& reply){
+        reply.clear();
+        if (packet.empty()) return true;
+        const char kind = packet[0];
+        const std::string args = packet.substr(1);
+        switch (kind)
+        {
+        case '\x03': reply = StopReply(SIGNAL_INT); return true;
+        case '?': reply = StopReply(lastSignal); return true;
+        case 'g': reply = ReadRegisters(); return true;
+        case 'G': reply = WriteRegisters(args); return true;
+        case 'p': reply = ReadRegister(args); return true;
+        case 'P': reply = WriteRegister(args); return true;
+        case 'm': reply = ReadMemory(args); return true;
+        case 'M': reply = WriteMemory(args); return true;
+        case 'Z': reply = SetBreakpoint(args, true); return true;
+        case 'z': reply = SetBreakpoint(args, false); return true;
+        case 's': reply = Resume(true); return true;
+        case 'c': reply = Resume(false); return true;
+        case 'H': reply = "OK"; return true; // a single thread
+        case 'T': reply = "OK"; return true;
+        case 'D': reply = "OK"; done = true; return true;
+        case 'k': done = true; return false;
+        case 'R': Restart(); return false;
+        case 'q': reply = Query(args); return true;
+        case 'Q': reply = (packet == "QStartNoAckMode") ? "OK" : ""; return true;
+        case 'v':
+            if (packet.compare(0, 6, "vKill;") == 0) { done = true; reply = "OK"; }
+            return true; // vCont and vMustReplyEmpty stay unsupported (empty reply)
+        default:
+            return true; // unsupported: empty reply
+        }
+    }
+
+private:
+    static const int SIGNAL_INT = 2;
+    static const int SIGNAL_TRAP = 5;
+
+    CPU4bit& cpu;
+    CPUState initial;
+    Breakpoints breakpoints;
+    uint16_t accessWatch = 0; // cells set through Z4, reported as "awatch"
+    FifoInput input;
+    GdbConnection* link = nullptr;
+    int lastSignal = SIGNAL_TRAP;
+    std::string lastStopInfo;
+    uint64_t executed = 0;
+    bool done = false;
+
+    static std::string Hex(const std::string& bytes){
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (unsigned char ch : bytes) { out += digits[ch >> 4]; out += digits[ch & 0xF]; }
+        return out;
+    }
+
+    static std::string HexByte(uint8_t v){ return Hex(std::string(1, (char)v)); }
+
+    static bool ParseHex(const std::string& text, size_t& pos, uint32_t& out){
+        size_t start = pos;
+        out = 0;
+        while (pos < text.size() && GdbConnection::HexValue(text[pos]) >= 0 && pos - start < 8)
+        {
+            out = out << 4 | (uint32_t)GdbConnection::HexValue(text[pos++]);
+        }
+        return pos > start;
+    }
+
+    static bool DecodeHex(const std::string& text, size_t pos, std::vector<uint8_t>& out){
+        for (; pos + 1 < text.size(); pos += 2)
+        {
+            int hi = GdbConnection::HexValue(text[pos]), lo = GdbConnection::HexValue(text[pos + 1]);
+            if (hi < 0 || lo < 0) return false;
+            out.push_back((uint8_t)(hi << 4 | lo));
+        }
+        return pos == text.size();
+    }
+
+    uint8_t RegisterValue(int n) const {
+        switch (n)
+        {
+        case 0: return cpu.ACC;
+        case 1: return cpu.PC;
+        case 2: return cpu.SP;
+        case 3: return cpu.IR;
+        case 4: return cpu.Z;
+        default: return cpu.C;
+        }
+    }
+
+    void SetRegister(int n, uint8_t value){
+        if (n == 4) cpu.Z = (value != 0);
+        else if (n == 5) cpu.C = (value != 0);
+        else if (n == 0) cpu.ACC = value & 0xF;
+        else if (n == 1) cpu.PC = value;
+        else if (n == 2) cpu.SP = value < cpu.STACK.size() ? value : (uint8_t)cpu.STACK.size();
+        else cpu.IR = value;
+    }
+
+    std::string ReadRegisters() const {
+        std::string out;
+        for (int n = 0; n < GdbLayout::REGISTERS; ++n) out += HexByte(RegisterValue(n));
+        return out;
+    }
+
+    std::string WriteRegisters(const std::string& args){
+        std::vector<uint8_t> bytes;
+        if (!DecodeHex(args, 0, bytes) || bytes.size() < (size_t)GdbLayout::REGISTERS) return "E01";
+        for (int n = 0; n < GdbLayout::REGISTERS; ++n) SetRegister(n, bytes[n]);
+        return "OK";
+    }
+
+    std::string ReadRegister(const std::string& args) const {
+        size_t pos = 0;
+        uint32_t n = 0;
+        if (!ParseHex(args, pos, n) || n >= (uint32_t)GdbLayout::REGISTERS) return "E01";
+        return HexByte(RegisterValue((int)n));
+    }
+
+    std::string WriteRegister(const std::string& args){
+        size_t pos = 0;
+        uint32_t n = 0;
+        std::vector<uint8_t> bytes;
+        if (!ParseHex(args, pos, n) || n >= (uint32_t)GdbLayout::REGISTERS || pos >= args.size() || args[pos] != '=' ||
+            !DecodeHex(args, pos + 1, bytes) || bytes.empty()) return "E01";
+        SetRegister((int)n, bytes[0]);
+        return "OK";
+    }
+
+    // -1 if `addr` is not mapped.
+    int ReadByteAt(uint32_t addr) const {
+        if (addr < GdbLayout::ROM_BASE + 256) return cpu.ROM[addr - GdbLayout::ROM_BASE];
+        if (addr >= GdbLayout::RAM_BASE && addr < GdbLayout::RAM_BASE + 16) return cpu.ReadRAM((uint8_t)(addr - GdbLayout::RAM_BASE));
+        if (addr >= GdbLayout::STACK_BASE && addr < GdbLayout::STACK_BASE + cpu.STACK.size()) return cpu.STACK[addr - GdbLayout::STACK_BASE];
+        return -1;
+    }
+
+    bool WriteByteAt(uint32_t addr, uint8_t value){
+        if (addr < GdbLayout::ROM_BASE + 256) { cpu.WriteROM((uint8_t)(addr - GdbLayout::ROM_BASE), value); return true; }
+        if (addr >= GdbLayout::RAM_BASE && addr < GdbLayout::RAM_BASE + 16) { cpu.SetRAM((int)(addr - GdbLayout::RAM_BASE), value); return true; }
+        if (addr >= GdbLayout::STACK_BASE && addr < GdbLayout::STACK_BASE + cpu.STACK.size()) { cpu.STACK[addr - GdbLayout::STACK_BASE] = value; return true; }
+        return false;
+    }
+
+    static bool ParseRange(const std::string& args, size_t& pos, uint32_t& addr, uint32_t& length){
+        if (!ParseHex(args, pos, addr) || pos >= args.size() || args[pos++] != ',') return false;
+        return ParseHex(args, pos, length);
+    }
+
+    // A read that runs past the end of a region returns the mapped part, as GDB expects.
+    std::string ReadMemory(const std::string& args) const {
+        size_t pos = 0;
+        uint32_t addr = 0, length = 0;
+        if (!ParseRange(args, pos, addr, length)) return "E01";
+        std::string out;
+        for (uint32_t i = 0; i < length && i < 0x1000; ++i)
+        {
+            int v = ReadByteAt(addr + i);
+            if (v < 0) break;
+            out += HexByte((uint8_t)v);
+        }
+        return out.empty() && length ? "E14" : out; // 0x14 = EFAULT
+    }
+
+    std::string WriteMemory(const std::string& args){
+        size_t pos = 0;
+        uint32_t addr = 0, length = 0;
+        std::vector<uint8_t> bytes;
+        if (!ParseRange(args, pos, addr, length) || pos >= args.size() || args[pos] != ':' ||
+            !DecodeHex(args, pos + 1, bytes) || bytes.size() != length) return "E01";
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            if (ReadByteAt(addr + i) < 0) return "E14";
+        }
+        for (uint32_t i = 0; i < length; ++i) WriteByteAt(addr + i, bytes[i]);
+        return "OK";
+    }
+
+    // "type,addr,kind". Types 0/1 are code breakpoints, 2/3/4 write/read/access watchpoints.
+    std::string SetBreakpoint(const std::string& args, bool insert){
+        size_t pos = 0;
+        uint32_t type = 0, addr = 0, length = 1;
+        if (!ParseHex(args, pos, type) || pos >= args.size() || args[pos++] != ',' || !ParseHex(args, pos, addr)) return "E01";
+        if (pos < args.size() && args[pos] == ',') { pos++; ParseHex(args, pos, length); }
+
+        if (type <= 1) {
+            if (addr >= GdbLayout::ROM_BASE + 256) return "E01";
+            if (insert) breakpoints.SetPC((uint8_t)addr); else breakpoints.RemovePC((uint8_t)addr);
+            return "OK";
+        }
+        if (type > 4) return "";
+        if (addr < GdbLayout::RAM_BASE || addr >= GdbLayout::RAM_BASE + 16) return "E01";
+        uint16_t cells = 0;
+        for (uint32_t i = 0; i < (length ? length : 1) && addr - GdbLayout::RAM_BASE + i < 16; ++i)
+        {
+            cells |= (uint16_t)(1u << (addr - GdbLayout::RAM_BASE + i));
+        }
+        uint16_t read = breakpoints.ReadWatch(), write = breakpoints.WriteWatch();
+        uint16_t* masks[2] = { (type != 3) ? &write : nullptr, (type != 2) ? &read : nullptr };
+        for (uint16_t* mask : masks)
+        {
+            if (mask) *mask = insert ? (uint16_t)(*mask | cells) : (uint16_t)(*mask & ~cells);
+        }
+        breakpoints.SetWatch(read, write);
+        if (type == 4) accessWatch = insert ? (uint16_t)(accessWatch | cells) : (uint16_t)(accessWatch & ~cells);
+        return "OK";
+    }
+
+    void Console(const std::string& text){
+        if (link) link->SendPacket("O" + Hex(text));
+    }
+
+    // Runs (or steps) until a breakpoint, watchpoint, HLT, missing input or Ctrl-C.
+    std::string Resume(bool step){
+        lastStopInfo.clear();
+        lastSignal = SIGNAL_TRAP;
+        breakpoints.ClearHit();
+        while (true)
+        {
+            if (cpu.isHalted()) {
+                Console("CPU halted (HLT)\n");
+                break;
+            }
+            if (cpu.isWaitingForInput) {
+                if (!cpu.PollInput()) {
+                    Console("LDA 14 is waiting for input: monitor input N\n");
+                    break;
+                }
+                if (breakpoints.InputDelivered()) {
+                    lastStopInfo = HitInfo(breakpoints.Hit());
+                    break;
+                }
+                if (step) break; // the input completes the LDA 14 being stepped
+                continue;
+            }
+
+            uint64_t budget = step ? 1 : SLICE;
+            if (!breakpoints.Any()) cpu.ClearTraps();
+            RunResult r = breakpoints.Any() ? breakpoints.Run(cpu, budget) : cpu.RunFor(budget);
+            executed += r.executed;
+            if (r.reason == StopReason::Predicate) {
+                lastStopInfo = HitInfo(breakpoints.Hit());
+                break;
+            }
+            if (step) break;
+            if (r.reason == StopReason::Budget && link && link->InterruptRequested()) {
+                lastSignal = SIGNAL_INT;
+                break;
+            }
+        }
+        return StopReply(lastSignal);
+    }
+
+    std::string HitInfo(const BreakHit& hit) const {
+        switch (hit.kind)
+        {
+        case BREAK_PC: return "swbreak:;";
+        case BREAK_READ:
+        case BREAK_WRITE: {
+            const char* kind = ((accessWatch >> hit.where) & 1) ? "awatch" : (hit.kind == BREAK_READ ? "rwatch" : "watch");
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%s:%x;", kind, (unsigned)(GdbLayout::RAM_BASE + hit.where));
+            return buf;
+        }
+        default: return "";
+        }
+    }
+
+    std::string StopReply(int signal){
+        lastSignal = signal;
+        std::string reply = "T" + HexByte((uint8_t)signal) + "01:" + HexByte(cpu.PC) + ";thread:1;";
+        if (signal == SIGNAL_TRAP) reply += lastStopInfo;
+        return reply;
+    }
+
+    void Restart(){
+        cpu.Restore(initial);
+        breakpoints.ClearHit();
+        lastStopInfo.clear();
+        lastSignal = SIGNAL_TRAP;
+    }
+
+    static std::string TargetXML(){
+        return "<?xml version=\"1.0\"?>\n"
+               "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+               "<target version=\"1.0\">\n"
+               "<feature name=\"org.cpu4bit.core\">\n"
+               "<reg name=\"acc\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>\n"
+               "<reg name=\"pc\" bitsize=\"8\" type=\"uint8\" regnum=\"1\"/>\n"
+               "<reg name=\"sp\" bitsize=\"8\" type=\"uint8\" regnum=\"2\"/>\n"
+               "<reg name=\"ir\" bitsize=\"8\" type=\"uint8\" regnum=\"3\"/>\n"
+               "<reg name=\"z\" bitsize=\"8\" type=\"uint8\" regnum=\"4\"/>\n"
+               "<reg name=\"c\" bitsize=\"8\" type=\"uint8\" regnum=\"5\"/>\n"
+               "</feature>\n"
+               "</target>\n";
+    }
+
+    static std::string MemoryMapXML(){
+        return "<?xml version=\"1.0\"?>\n"
+               "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\" \"http://sourceware.org/gdb/gdb-memory-map.dtd\">\n"
+               "<memory-map>\n"
+               "<memory type=\"ram\" start=\"0x0\" length=\"0x100\"/>\n"
+               "<memory type=\"ram\" start=\"0x800000\" length=\"0x10\"/>\n"
+               "<memory type=\"ram\" start=\"0x810000\" length=\"0x10\"/>\n"
+               "</memory-map>\n";
+    }
+
+    // "annex:offset,length" of a qXfer read.
+    static std::string Transfer(const std::string& document, const std::string& range){
+        size_t pos = 0;
+        uint32_t offset = 0, length = 0;
+        if (!ParseRange(range, pos, offset, length)) return "E01";
+        if (offset >= document.size()) return "l";
+        std::string chunk = document.substr(offset, length);
+        return (offset + chunk.size() >= document.size() ? "l" : "m") + chunk;
+    }
+
+    std::string Monitor(const std::string& command){
+        if (command.compare(0, 6, "input ") == 0) {
+            std::vector<uint8_t> values;
+            std::string list = command.substr(6);
+            for (size_t start = 0; start <= list.size();)
+            {
+                size_t end = list.find(',', start);
+                if (end == std::string::npos) end = list.size();
+                char* stop = nullptr;
+                std::string token = list.substr(start, end - start);
+                long v = std::strtol(token.c_str(), &stop, 0);
+                if (token.empty() || *stop != '\0' || v < 0) return Hex("usage: monitor input N[,N...]\n");
+                values.push_back((uint8_t)(v & 0xF));
+                start = end + 1;
+            }
+            QueueInputs(values);
+            return Hex(std::to_string(input.Remaining()) + " input value(s) queued\n");
+        }
+        if (command == "reset") {
+            Restart();
+            return Hex("program reloaded\n");
+        }
+        if (command == "status") {
+            char buf[160];
+            std::snprintf(buf, sizeof(buf), "pc=%d acc=%d z=%d c=%d sp=%d leds=%d halted=%d waiting=%d executed=%llu\n",
+                cpu.PC, cpu.ACC, cpu.Z ? 1 : 0, cpu.C ? 1 : 0, cpu.SP, cpu.getGPIO().getLEDs(), cpu.isHalted() ? 1 : 0,
+                cpu.isWaitingForInput ? 1 : 0, (unsigned long long)executed);
+            return Hex(buf + cpu.ConsoleText() + "\n");
+        }
+        return Hex("monitor commands: input N[,N...] | reset | status\n");
+    }
+
+    std::string Query(const std::string& args){
+        if (args.compare(0, 9, "Supported") == 0) {
+            return "PacketSize=1000;QStartNoAckMode+;qXfer:features:read+;qXfer:memory-map:read+;swbreak+;hwbreak+";
+        }
+        const std::string features = "Xfer:features:read:target.xml:";
+        if (args.compare(0, features.size(), features) == 0) return Transfer(TargetXML(), args.substr(features.size()));
+        if (args.compare(0, 20, "Xfer:memory-map:read") == 0) {
+            size_t colon = args.find(':', 21);
+            return colon == std::string::npos ? "E01" : Transfer(MemoryMapXML(), args.substr(colon + 1));
+        }
+        if (args.compare(0, 5, "Rcmd,") == 0) {
+            std::vector<uint8_t> bytes;
+            if (!DecodeHex(args, 5, bytes)) return "E01";
+            return Monitor(std::string(bytes.begin(), bytes.end()));
+        }
+        if (args == "Attached") return "1";
+        if (args == "C") return "QC1";
+        if (args == "fThreadInfo") return "m1";
+        if (args == "sThreadInfo") return "l";
+        return "";
+    }
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+// Execution history: the CPUState after every instruction, stored as a full keyframe every
+// KEYFRAME_INTERVAL steps plus a byte-level delta for each step in between.
+//
+// Delta record (state N-1 -> state N, both seen as 64 raw bytes):
+//   [mask]            bit i set: byte i of the register/flag word changed
+//   [value]...        one byte per set bit (ACC, PC, IR, SP, Z, C, halted, waiting)
+//   [n]               number of other changed bytes (RAM, STACK, GPIO, console)
+//   [offset value]... n pairs
+// A typical instruction changes PC, IR and ACC/Z (5-6 bytes); a store adds one pair.
+// Stored states are never modified; StateAt() rebuilds a copy from the nearest keyframe.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "CPU.h"
+
+class StateHistory : public NoHooks {
+public:
+    static const uint64_t KEYFRAME_INTERVAL = 1024;
+
+    // Starts a new history whose step 0 is `initial`.
+    void Begin(const CPUState& initial){
+        keyframes.clear();
+        keyframeOffsets.clear();
+        deltas.clear();
+        keyframes.push_back(initial);
+        keyframeOffsets.push_back(0);
+        last = initial;
+        steps = 0;
+    }
+
+    // Appends the state after one more instruction.
+    void Record(const CPUState& state){
+        EncodeDelta(last, state);
+        last = state;
+        steps++;
+        if (steps % KEYFRAME_INTERVAL == 0) {
+            keyframes.push_back(state);
+            keyframeOffsets.push_back(deltas.size());
+        }
+    }
+
+    // RunHooked() observer: records the state after each instruction.
+    bool AfterExecute(const CPU4bit& cpu){
+        Record(cpu.State());
+        return false;
+    }
+
+    uint64_t Steps() const { return steps; } // states 0..Steps() are available
+    const CPUState& Latest() const { return last; }
+
+    // State after `step` instructions. Returns false if that step was never recorded.
+    bool StateAt(uint64_t step, CPUState& out) const {
+        if (step > steps) return false;
+        size_t pos = 0;
+        Seek(step, out, pos);
+        return true;
+    }
+
+    // Forgets every state after `step`, e.g. before recording a different future.
+    void Truncate(uint64_t step){
+        if (step >= steps) return;
+        CPUState state;
+        size_t pos = 0;
+        Seek(step, state, pos);
+        deltas.resize(pos);
+        size_t keep = (size_t)(step / KEYFRAME_INTERVAL) + 1;
+        keyframes.resize(keep);
+        keyframeOffsets.resize(keep);
+        last = state;
+        steps = step;
+    }
+
+    size_t MemoryBytes() const {
+        return deltas.size() + keyframes.size() * (sizeof(CPUState) + sizeof(uint64_t));
+    }
+
+private:
+    std::vector<CPUState> keyframes;       // state at step k * KEYFRAME_INTERVAL
+    std::vector<uint64_t> keyframeOffsets; // deltas offset of the record following keyframe k
+    std::vector<uint8_t> deltas;
+    CPUState last;
+    uint64_t steps = 0;
+
+    // Rebuilds the state at `step`; `pos` ends at the delta record of step + 1.
+    void Seek(uint64_t step, CPUState& out, size_t& pos) const {
+        size_t k = (size_t)(step / KEYFRAME_INTERVAL);
+        out = keyframes[k];
+        pos = (size_t)keyframeOffsets[k];
+        uint8_t bytes[sizeof(CPUState)];
+        std::memcpy(bytes, &out, sizeof(CPUState));
+        for (uint64_t i = 0; i < step % KEYFRAME_INTERVAL; ++i) pos = ApplyDelta(bytes, pos);
+        std::memcpy(&out, bytes, sizeof(CPUState));
+    }
+
+    void EncodeDelta(const CPUState& from, const CPUState& to){
+        uint8_t a[sizeof(CPUState)], b[sizeof(CPUState)];
+        std::memcpy(a, &from, sizeof(CPUState));
+        std::memcpy(b, &to, sizeof(CPUState));
+
+        uint8_t mask = 0;
+        for (int i = 0; i < 8; ++i) if (a[i] != b[i]) mask |= (uint8_t)(1 << i);
+        deltas.push_back(mask);
+        for (int i = 0; i < 8; ++i) if (mask & (1 << i)) deltas.push_back(b[i]);
+
+        size_t countPos = deltas.size();
+        deltas.push_back(0);
+        uint8_t count = 0;
+        for (size_t w = 8; w < sizeof(CPUState); w += 8)
+        {
+            uint64_t x, y;
+            std::memcpy(&x, a + w, 8);
+            std::memcpy(&y, b + w, 8);
+            if (x == y) continue; // most of the state is untouched by any one instruction
+            for (size_t i = w; i < w + 8; ++i)
+            {
+                if (a[i] == b[i]) continue;
+                deltas.push_back((uint8_t)i);
+                deltas.push_back(b[i]);
+                count++;
+            }
+        }
+        deltas[countPos] = count;
+    }
+
+    size_t ApplyDelta(uint8_t* bytes, size_t pos) const {
+        uint8_t mask = deltas[pos++];
+        for (int i = 0; i < 8; ++i) if (mask & (1 << i)) bytes[i] = deltas[pos++];
+        uint8_t count = deltas[pos++];
+        for (uint8_t n = 0; n < count; ++n, pos += 2) bytes[deltas[pos]] = deltas[pos + 1];
+        return pos;
+    }
+};
+
+// Runs like CPU4bit::RunFor() and records every executed instruction into `history`.
+inline RunResult RunRecorded(CPU4bit& cpu, StateHistory& history, uint64_t budget){
+    return cpu.RunHooked(history, budget);
+}
+
+#endif
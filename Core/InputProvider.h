@@ -0,0 +1,129 @@
+#ifndef INPUT_PROVIDER_H
+#define INPUT_PROVIDER_H
+
+// Sources for LDA 14.
+//
+// A CPU4bit with a provider (SetInputProvider) asks it synchronously when LDA 14 executes. If
+// a value is available the load completes inside the run loop like any other instruction;
+// only when the provider has nothing does the CPU stop with isWaitingForInput. The host then
+// hands over a value with ResolveInput(), or calls PollInput() once the provider has one.
+// Without a provider every LDA 14 stops the run, as before.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class InputProvider {
+public:
+    virtual ~InputProvider() = default;
+
+    // Stores the next input in `value` and returns true, or returns false if none is
+    // available yet (the CPU then waits).
+    virtual bool NextInput(uint8_t& value) = 0;
+};
+
+// "3,4,0xF 7" -> {3,4,15,7}. Separators: comma, whitespace. Values are masked to a nibble;
+// ';' or '#' starts a comment that runs to the end of the line.
+inline bool ParseNibbleList(const std::string& text, std::vector<uint8_t>& out){
+    std::string token;
+    std::stringstream ss(text);
+    char ch;
+    auto flush = [&]() -> bool {
+        if (token.empty()) return true;
+        char* end = nullptr;
+        long val = std::strtol(token.c_str(), &end, 0);
+        if (end == token.c_str() || *end != '\0' || val < 0) return false;
+        out.push_back((uint8_t)(val & 0xF));
+        token.clear();
+        return true;
+    };
+    while (ss.get(ch))
+    {
+        if (ch == ',' || ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+            if (!flush()) return false;
+        } else if (ch == ';' || ch == '#') { // comment until end of line
+            if (!flush()) return false;
+            while (ss.get(ch) && ch != '\n') {}
+        } else {
+            token += ch;
+        }
+    }
+    return flush();
+}
+
+// Values handed out in the order they were pushed (grading inputs, debugger "monitor input",
+// the GUI's keyboard and switch entry). Single-threaded: feed it from the thread that runs the CPU.
+class FifoInput : public InputProvider {
+public:
+    FifoInput() = default;
+    explicit FifoInput(std::vector<uint8_t> initial) : values(std::move(initial)) {}
+
+    void Push(uint8_t value){
+        Compact();
+        values.push_back(value);
+    }
+
+    void Push(const std::vector<uint8_t>& more){
+        Compact();
+        values.insert(values.end(), more.begin(), more.end());
+    }
+
+    void Clear(){ values.clear(); next = 0; }
+
+    size_t Remaining() const { return values.size() - next; }
+    uint64_t Consumed() const { return consumed; }
+
+    bool NextInput(uint8_t& value) override {
+        if (next == values.size()) return false;
+        value = values[next++];
+        consumed++;
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> values;
+    size_t next = 0;
+    uint64_t consumed = 0;
+
+    void Compact(){
+        if (next == values.size()) { values.clear(); next = 0; }
+    }
+};
+
+// A FIFO filled from a script of nibbles in the ParseNibbleList() format.
+class ScriptedInput : public FifoInput {
+public:
+    bool LoadText(const std::string& text){
+        std::vector<uint8_t> parsed;
+        if (!ParseNibbleList(text, parsed)) return false;
+        Clear();
+        Push(parsed);
+        return true;
+    }
+
+    bool LoadFile(const std::string& path){
+        std::ifstream file(path);
+        if (!file.is_open()) return false;
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return LoadText(buffer.str());
+    }
+};
+
+// Any callable `bool(uint8_t& value)`, e.g. a random source or a test harness.
+class CallbackInput : public InputProvider {
+public:
+    explicit CallbackInput(std::function<bool(uint8_t&)> source) : next(std::move(source)) {}
+
+    bool NextInput(uint8_t& value) override { return next && next(value); }
+
+private:
+    std::function<bool(uint8_t&)> next;
+};
+
+#endif
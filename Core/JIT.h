@@ -0,0 +1,421 @@
+#ifndef JIT_H
+#define JIT_H
+
+// Block-level x86-64 JIT for CPU4bit.
+//
+// Straight-line runs of ALU/memory instructions are translated to native code with
+// ACC, Z and C pinned in host registers (ecx, edx, r8d) and RAM addressed as a 16-byte
+// block through rdi. A block ends at JMP/JZ/JC (resolved natively) or just before any
+// instruction that needs the interpreter: LDA 14 (input), CALL, RET, PUSH, POP, OUT,
+// RST and HLT. Those are executed one at a time by CPU4bit::Run(1).
+//
+// Blocks for all 256 entry points are compiled at once whenever CPU4bit::romVersion
+// changes, then the code buffer is flipped to read+execute.
+// On other hosts (or if mmap fails) Run() simply forwards to the interpreter.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+// Generated code stores whole bytes into a 16-byte RAM image, which the nibble-packed
+// layout cannot represent (STAI), so packed builds always take the interpreter path.
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(CPU4BIT_PACKED_RAM)
+#define CPU4BIT_JIT_X64 1
+#include <sys/mman.h>
+#else
+#define CPU4BIT_JIT_X64 0
+#endif
+
+// Memory seen by the generated code (rdi points here)
+struct JitContext {
+    uint8_t ram[16];   // offset 0
+    uint8_t acc;       // offset 16
+    uint8_t z;         // offset 17
+    uint8_t c;         // offset 18
+    uint8_t led;       // offset 19 : last value written by STA 15
+    uint8_t ledDirty;  // offset 20
+};
+
+class CPU4bitJIT {
+public:
+    static const int MAX_BLOCK_INSTRUCTIONS = 32;
+
+    explicit CPU4bitJIT(CPU4bit& target) : cpu(target) {}
+    ~CPU4bitJIT(){ ReleaseCode(); }
+
+    CPU4bitJIT(const CPU4bitJIT&) = delete;
+    CPU4bitJIT& operator=(const CPU4bitJIT&) = delete;
+
+    static bool IsSupported(){ return CPU4BIT_JIT_X64 != 0; }
+
+    // Same contract as CPU4bit::Run: returns on HLT, input request or budget exhaustion.
+    // Traps (CPU4bit::SetTraps) are ignored: compiled blocks never see them and the
+    // interpreter fallback steps through the plain decode cache, not the dispatch table.
+    uint64_t Run(uint64_t budget){
+        if (cpu.isHalted() || cpu.isWaitingForInput) return 0;
+        if (!EnsureCompiled()) {
+            NoHooks none;
+            return cpu.RunHooked(none, budget).executed;
+        }
+
+        JitContext ctx;
+        LoadContext(ctx);
+        uint8_t pc = cpu.PC;
+        uint64_t executed = 0;
+
+        while (executed < budget)
+        {
+            const Block& b = blocks[pc];
+            if (b.fn && b.length <= budget - executed) {
+                pc = (uint8_t)b.fn(&ctx);
+                cpu.IR = b.lastIR;
+                executed += b.length;
+                continue;
+            }
+            // Interpreter path: one instruction
+            cpu.PC = pc;
+            StoreContext(ctx);
+            cpu.Step();
+            executed++;
+            if (cpu.isHalted() || cpu.isWaitingForInput) return executed;
+            LoadContext(ctx);
+            pc = cpu.PC;
+        }
+        cpu.PC = pc;
+        StoreContext(ctx);
+        return executed;
+    }
+
+    // Differential mode: every block also runs on an interpreter copy of the CPU and the
+    // architectural state is compared afterwards. Stops at the first divergence and
+    // describes it in `report` (returns false); returns true when the run ends in agreement.
+    bool RunLockstep(uint64_t budget, uint64_t& executed, std::string& report){
+        CPU4bit shadow = cpu;
+        shadow.SetInputProvider(nullptr); // gets the value the provider handed `cpu` instead
+        shadow.SetOutputLog(nullptr);     // `cpu` already records the outputs
+        shadow.ClearTraps();              // Run() ignores them, so the shadow must too
+        executed = 0;
+        while (executed < budget && !cpu.isHalted() && !cpu.isWaitingForInput)
+        {
+            uint8_t startPC = cpu.PC;
+            uint8_t handler = cpu.decoded[startPC].handler;
+            if (handler == Decode::OP_LDA_DEV || handler == Decode::OP_STA_DEV) {
+                // Devices are shared and stateful: run the access once and let the shadow follow
+                executed += Run(1);
+                shadow.Restore(cpu.State());
+                continue;
+            }
+            uint64_t chunk = 1;
+            if (EnsureCompiled() && blocks[startPC].fn) chunk = blocks[startPC].length;
+            if (chunk > budget - executed) chunk = budget - executed;
+
+            uint64_t n = Run(chunk);
+            uint64_t m = shadow.Run(chunk);
+            if (shadow.isWaitingForInput && !cpu.isWaitingForInput) shadow.ResolveInput((int)cpu.console.lastValue);
+            executed += n;
+            if (n != m || !SameState(cpu, shadow)) {
+                report = "JIT diverged from interpreter in block at PC " + std::to_string(startPC) +
+                         " (after " + std::to_string(executed) + " instructions)";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool SameState(const CPU4bit& a, const CPU4bit& b){
+        return a.PC == b.PC && a.ACC == b.ACC && a.IR == b.IR && a.SP == b.SP &&
+               a.Z == b.Z && a.C == b.C && a.halted == b.halted &&
+               a.isWaitingForInput == b.isWaitingForInput &&
+               a.RAM == b.RAM && a.STACK == b.STACK &&
+               a.getGPIO().getLEDs() == b.getGPIO().getLEDs();
+    }
+
+private:
+    typedef uint32_t (*BlockFn)(JitContext*);
+
+    struct Block {
+        BlockFn fn = nullptr; // null: first instruction needs the interpreter
+        uint8_t length = 0;   // instructions executed by one call
+        uint8_t lastIR = 0;   // IR after the block (opcode byte of its last instruction)
+    };
+
+    CPU4bit& cpu;
+    Block blocks[256];
+    uint32_t compiledVersion = 0;
+    bool compiledOnce = false;
+    uint8_t* code = nullptr;
+    size_t codeSize = 0;
+
+    void LoadContext(JitContext& ctx) const {
+        cpu.CopyRAMTo(ctx.ram);
+        ctx.acc = cpu.ACC;
+        ctx.z = cpu.Z ? 1 : 0;
+        ctx.c = cpu.C ? 1 : 0;
+        ctx.led = 0;
+        ctx.ledDirty = 0;
+    }
+
+    void StoreContext(const JitContext& ctx){
+        cpu.CopyRAMFrom(ctx.ram);
+        cpu.ACC = ctx.acc;
+        cpu.Z = ctx.z != 0;
+        cpu.C = ctx.c != 0;
+        if (ctx.ledDirty) cpu.getGPIO().WriteOutputPort(ctx.led);
+    }
+
+    void ReleaseCode(){
+#if CPU4BIT_JIT_X64
+        if (code) munmap(code, codeSize);
+#endif
+        code = nullptr;
+        codeSize = 0;
+    }
+
+    static bool IsNative(uint8_t handler){
+        switch (handler)
+        {
+        case Decode::OP_NOP: case Decode::OP_LDA: case Decode::OP_LDI:
+        case Decode::OP_STA: case Decode::OP_STA_GPIO:
+        case Decode::OP_ADD: case Decode::OP_SUB: case Decode::OP_AND:
+        case Decode::OP_OR: case Decode::OP_XOR: case Decode::OP_LDAI:
+        case Decode::OP_STAI: case Decode::OP_NOT:
+        case Decode::OP_JMP: case Decode::OP_JZ: case Decode::OP_JC:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool IsBranch(uint8_t handler){
+        return handler == Decode::OP_JMP || handler == Decode::OP_JZ || handler == Decode::OP_JC;
+    }
+
+#if CPU4BIT_JIT_X64
+    // --- x86-64 emitter -------------------------------------------------------
+    // Register numbers: 0 eax, 1 ecx, 2 edx, 7 rdi, 8 r8, 9 r9
+    enum { RAX = 0, RCX = 1, RDX = 2, RDI = 7, R8 = 8, R9 = 9 };
+    enum { REG_ACC = RCX, REG_Z = RDX, REG_C = R8 };
+    enum { CTX_ACC = 16, CTX_Z = 17, CTX_C = 18, CTX_LED = 19, CTX_LED_DIRTY = 20 };
+
+    struct Emitter {
+        std::vector<uint8_t> bytes;
+        void Byte(uint8_t b){ bytes.push_back(b); }
+        void Imm32(uint32_t v){ for (int i = 0; i < 4; ++i) Byte((uint8_t)(v >> (8 * i))); }
+        static uint8_t ModRM(int mod, int reg, int rm){ return (uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+        // movzx r32, byte [rdi + disp8]
+        void LoadByte(int r, uint8_t disp){
+            if (r >= 8) Byte(0x44);
+            Byte(0x0F); Byte(0xB6); Byte(ModRM(1, r, RDI)); Byte(disp);
+        }
+        // movzx r32, byte [rdi + rax]
+        void LoadByteIndexed(int r){
+            if (r >= 8) Byte(0x44);
+            Byte(0x0F); Byte(0xB6); Byte(ModRM(0, r, 4)); Byte(0x07);
+        }
+        // mov byte [rdi + disp8], r8
+        void StoreByte(uint8_t disp, int r){
+            if (r >= 8) Byte(0x44);
+            Byte(0x88); Byte(ModRM(1, r, RDI)); Byte(disp);
+        }
+        // mov byte [rdi + rax], r8
+        void StoreByteIndexed(int r){
+            if (r >= 8) Byte(0x44);
+            Byte(0x88); Byte(ModRM(0, r, 4)); Byte(0x07);
+        }
+        // mov byte [rdi + disp8], imm8
+        void StoreImm8(uint8_t disp, uint8_t imm){
+            Byte(0xC6); Byte(ModRM(1, 0, RDI)); Byte(disp); Byte(imm);
+        }
+        // mov r32, imm32
+        void MovImm(int r, uint32_t imm){
+            if (r >= 8) Byte(0x41);
+            Byte((uint8_t)(0xB8 + (r & 7))); Imm32(imm);
+        }
+        // <op> dst32, src32  (op: 0x01 add, 0x29 sub, 0x21 and, 0x09 or, 0x31 xor, 0x89 mov, 0x85 test)
+        void AluRR(uint8_t op, int dst, int src){
+            uint8_t rex = 0x40 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0);
+            if (rex != 0x40) Byte(rex);
+            Byte(op); Byte(ModRM(3, src, dst));
+        }
+        // <op> r32, imm8  (ext: 4 and, 7 cmp)
+        void AluImm8(int ext, int r, uint8_t imm){
+            if (r >= 8) Byte(0x41);
+            Byte(0x83); Byte(ModRM(3, ext, r)); Byte(imm);
+        }
+        // not r32
+        void Not(int r){
+            if (r >= 8) Byte(0x41);
+            Byte(0xF7); Byte(ModRM(3, 2, r));
+        }
+        // setcc r8 (cc: 0x94 z, 0x92 b, 0x97 a)
+        void SetCC(uint8_t cc, int r){
+            if (r >= 8) Byte(0x41);
+            Byte(0x0F); Byte(cc); Byte(ModRM(3, 0, r));
+        }
+        // cmovcc dst32, src32 (cc: 0x45 nz)
+        void CMov(uint8_t cc, int dst, int src){
+            uint8_t rex = 0x40 | (dst >= 8 ? 4 : 0) | (src >= 8 ? 1 : 0);
+            if (rex != 0x40) Byte(rex);
+            Byte(0x0F); Byte(cc); Byte(ModRM(3, dst, src));
+        }
+        void Ret(){ Byte(0xC3); }
+    };
+
+    static void EmitExit(Emitter& e){
+        e.StoreByte(CTX_ACC, REG_ACC);
+        e.StoreByte(CTX_Z, REG_Z);
+        e.StoreByte(CTX_C, REG_C);
+    }
+
+    // Translates the block starting at `start`. Returns false if the first instruction
+    // has to run on the interpreter.
+    bool TranslateBlock(uint8_t start, Emitter& e, Block& block) const {
+        const Decode::DecodedOp* dec = cpu.decoded.data();
+        if (!IsNative(dec[start].handler)) return false;
+
+        e.LoadByte(REG_ACC, CTX_ACC);
+        e.LoadByte(REG_Z, CTX_Z);
+        e.LoadByte(REG_C, CTX_C);
+
+        uint8_t pc = start;
+        int count = 0;
+        while (true)
+        {
+            const Decode::DecodedOp op = dec[pc];
+            if (!IsNative(op.handler) || count == MAX_BLOCK_INSTRUCTIONS) {
+                EmitExit(e);
+                e.MovImm(RAX, pc);
+                e.Ret();
+                break;
+            }
+            block.lastIR = cpu.ROM[pc];
+            count++;
+            uint8_t next = (uint8_t)(pc + op.length);
+
+            switch (op.handler)
+            {
+            case Decode::OP_NOP:
+                break;
+            case Decode::OP_LDA:
+                e.LoadByte(REG_ACC, op.operand);
+                e.AluRR(0x85, REG_ACC, REG_ACC);
+                e.SetCC(0x94, REG_Z);
+                break;
+            case Decode::OP_LDI:
+                e.MovImm(REG_ACC, op.operand);
+                e.MovImm(REG_Z, op.operand == 0 ? 1 : 0);
+                break;
+            case Decode::OP_STA:
+            case Decode::OP_STA_GPIO:
+                e.AluRR(0x89, RAX, REG_ACC);
+                e.AluImm8(4, RAX, 0x0F);
+                e.StoreByte(op.operand, RAX);
+                if (op.handler == Decode::OP_STA_GPIO) {
+                    e.StoreByte(CTX_LED, RAX);
+                    e.StoreImm8(CTX_LED_DIRTY, 1);
+                }
+                break;
+            case Decode::OP_ADD:
+                e.LoadByte(RAX, op.operand);
+                e.AluRR(0x01, RAX, REG_ACC);
+                e.AluImm8(7, RAX, 15);
+                e.SetCC(0x97, REG_C);      // C = temp > 15
+                e.AluImm8(4, RAX, 0x0F);
+                e.SetCC(0x94, REG_Z);
+                e.AluRR(0x89, REG_ACC, RAX);
+                break;
+            case Decode::OP_SUB:
+                e.AluRR(0x89, RAX, REG_ACC);
+                e.LoadByte(R9, op.operand);
+                e.AluRR(0x29, RAX, R9);
+                e.SetCC(0x92, REG_C);      // C = borrow
+                e.AluImm8(4, RAX, 0x0F);
+                e.SetCC(0x94, REG_Z);
+                e.AluRR(0x89, REG_ACC, RAX);
+                break;
+            case Decode::OP_AND:
+            case Decode::OP_OR:
+            case Decode::OP_XOR:
+                e.LoadByte(RAX, op.operand);
+                e.AluRR(op.handler == Decode::OP_AND ? 0x21 : (op.handler == Decode::OP_OR ? 0x09 : 0x31), REG_ACC, RAX);
+                e.SetCC(0x94, REG_Z);
+                break;
+            case Decode::OP_LDAI:
+                e.LoadByte(RAX, op.operand);
+                e.AluImm8(4, RAX, 0x0F);
+                e.LoadByteIndexed(REG_ACC);
+                e.AluRR(0x85, REG_ACC, REG_ACC);
+                e.SetCC(0x94, REG_Z);
+                break;
+            case Decode::OP_STAI:
+                e.LoadByte(RAX, op.operand);
+                e.AluImm8(4, RAX, 0x0F);
+                e.StoreByteIndexed(REG_ACC);
+                break;
+            case Decode::OP_NOT:
+                e.Not(REG_ACC);
+                e.AluImm8(4, REG_ACC, 0x0F);
+                e.SetCC(0x94, REG_Z);
+                break;
+            case Decode::OP_JMP:
+                EmitExit(e);
+                e.MovImm(RAX, op.target);
+                e.Ret();
+                break;
+            case Decode::OP_JZ:
+            case Decode::OP_JC:
+                EmitExit(e);
+                e.MovImm(RAX, next);
+                e.MovImm(R9, op.target);
+                e.AluRR(0x85, op.handler == Decode::OP_JZ ? REG_Z : REG_C, op.handler == Decode::OP_JZ ? REG_Z : REG_C);
+                e.CMov(0x45, RAX, R9);
+                e.Ret();
+                break;
+            }
+            if (IsBranch(op.handler)) break;
+            pc = next;
+        }
+        block.length = (uint8_t)count;
+        return true;
+    }
+#endif
+
+    bool EnsureCompiled(){
+#if CPU4BIT_JIT_X64
+        if (compiledOnce && compiledVersion == cpu.romVersion) return code != nullptr;
+        ReleaseCode();
+        compiledOnce = true;
+        compiledVersion = cpu.romVersion;
+
+        Emitter e;
+        size_t offsets[256];
+        for (int addr = 0; addr < 256; ++addr)
+        {
+            blocks[addr] = Block();
+            offsets[addr] = e.bytes.size();
+            if (!TranslateBlock((uint8_t)addr, e, blocks[addr])) offsets[addr] = SIZE_MAX;
+        }
+
+        codeSize = (e.bytes.size() + 4095) & ~(size_t)4095;
+        void* mem = mmap(nullptr, codeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) { code = nullptr; codeSize = 0; return false; }
+        code = (uint8_t*)mem;
+        std::memcpy(code, e.bytes.data(), e.bytes.size());
+        if (mprotect(code, codeSize, PROT_READ | PROT_EXEC) != 0) { ReleaseCode(); return false; }
+
+        for (int addr = 0; addr < 256; ++addr)
+        {
+            if (offsets[addr] != SIZE_MAX) blocks[addr].fn = (BlockFn)(void*)(code + offsets[addr]);
+            else blocks[addr].fn = nullptr;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+};
+
+#endif
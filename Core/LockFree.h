@@ -0,0 +1,79 @@
+#ifndef LOCK_FREE_H
+#define LOCK_FREE_H
+
+// Wait-free primitives for handing data between exactly two threads.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Single-producer / single-consumer ring. Capacity must be a power of two; one slot is
+// never used so that head == tail always means empty.
+template <class T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue slots are copied by value");
+
+public:
+    // Producer thread only. Returns false (and drops nothing) when the ring is full.
+    bool Push(const T& item){
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) & (Capacity - 1);
+        if (next == headIndex.load(std::memory_order_acquire)) return false;
+        slots[tail] = item;
+        tailIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    bool Pop(T& item){
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) return false;
+        item = slots[head];
+        headIndex.store((head + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> slots;
+    alignas(64) std::atomic<size_t> headIndex{0}; // consumer side
+    alignas(64) std::atomic<size_t> tailIndex{0}; // producer side
+};
+
+// Latest-value mailbox. The writer fills its private back buffer and swaps it with the shared
+// middle one; the reader swaps the middle one into its private front buffer when it is newer.
+// Neither side ever waits, and the reader always sees a complete, immutable value.
+template <class T>
+class TripleBuffer {
+public:
+    // Writer thread only: the buffer to fill, then Publish().
+    T& Back(){ return buffers[backIndex]; }
+
+    void Publish(){
+        uint8_t old = middle.exchange((uint8_t)(backIndex | NEW_BIT), std::memory_order_acq_rel);
+        backIndex = old & INDEX_MASK;
+    }
+
+    // Reader thread only. Returns true if a newer value was picked up; Front() is valid either way.
+    bool Update(){
+        if (!(middle.load(std::memory_order_relaxed) & NEW_BIT)) return false;
+        uint8_t old = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = old & INDEX_MASK;
+        return true;
+    }
+
+    const T& Front() const { return buffers[frontIndex]; }
+
+private:
+    static const uint8_t NEW_BIT = 0x4;
+    static const uint8_t INDEX_MASK = 0x3;
+
+    T buffers[3] = {};
+    uint8_t backIndex = 0;                  // writer private
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t frontIndex = 2;     // reader private
+};
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef LOOP_ACCELERATOR_H
+#define LOOP_ACCELERATOR_H
+
+// Fast-forwards counting loops: whole iterations are applied at once instead of being
+// interpreted instruction by instruction.
+//
+// The target of every backward jump in the ROM is a loop header. The CPU's engine runs the
+// program and stops at the headers (traps); there one iteration of the body is walked
+// symbolically. Every value is kept as "header value of one cell (or
+// of ACC) + constant, mod 16". The loop qualifies when, over one iteration, each RAM cell and
+// a live-in ACC either moves by a fixed step (counter decrement, running sum) or is set to a
+// constant. The body may only use LDA, LDI, STA, ADD, SUB, NOP, JMP, JZ and JC. After k
+// iterations every value is then a closed form in k. Each JZ/JC of the body is re-evaluated for
+// k = 1, 2, ... until one of them would branch the other way. All the iterations before that
+// one are applied in a single update: RAM, ACC, Z, C, IR and the instruction count come out
+// exactly as if they had been interpreted. A body that writes the LED port (STA 15) or a device
+// is never skipped, since every value it puts on the pins must appear in turn.
+// Values are 4 bits and repeat every 16 iterations, so a bounded number of probes decides any loop.
+//
+// With `crossCheck` set every fast-forward is replayed by the interpreter and compared; on a
+// mismatch the interpreter's state is kept and Mismatches() counts it.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "CPU.h"
+
+class LoopAccelerator {
+public:
+    static const int MAX_BODY = 64;                // longest loop body analysed, in instructions
+    static const uint64_t RETRY_INTERVAL = 4096;   // engine instructions before failed headers are retried
+
+    bool crossCheck = false;
+
+    // Runs like CPU4bit::RunFor(), fast-forwarding loops where possible. `executed` counts
+    // every architectural instruction, skipped ones included. Everything between loop headers
+    // runs on the CPU's own engine, which stops at the headers through traps
+    // (CPU4bit::SetTraps); the traps stay installed after the call, as with Breakpoints::Run().
+    RunResult Run(CPU4bit& cpu, uint64_t budget, bool stopOnOutput = false){
+        if (cpu.romVersion != romVersion) FindHeaders(cpu);
+        RunResult total;
+        while (total.executed < budget)
+        {
+            if (retrying && sinceFailure >= RETRY_INTERVAL) {
+                failed = {};
+                retrying = false;
+                installedDispatch = 0;
+            }
+            if (installedDispatch != cpu.dispatchVersion) InstallTraps(cpu);
+
+            uint64_t chunk = budget - total.executed;
+            if (retrying) chunk = std::min(chunk, RETRY_INTERVAL - sinceFailure);
+            RunResult run = cpu.RunFor(chunk, stopOnOutput);
+            total.executed += run.executed;
+            sinceFailure += run.executed;
+            if (run.reason == StopReason::Budget) continue;
+            if (run.reason != StopReason::Trap) {
+                total.reason = run.reason;
+                return total;
+            }
+
+            // At a loop header. A loop that does not qualify loses its trap for a while.
+            uint64_t skipped = TrySkip(cpu, budget - total.executed);
+            total.executed += skipped;
+            if (skipped == 0 || total.executed == budget || !cpu.Trapped(cpu.PC)) continue;
+
+            // The next iteration leaves the analysed path: run the header past its trap.
+            NoHooks none;
+            RunResult step = cpu.RunHooked(none, 1, stopOnOutput);
+            total.executed += step.executed;
+            if (step.reason != StopReason::Budget) {
+                total.reason = step.reason;
+                return total;
+            }
+        }
+        total.reason = StopReason::Budget;
+        return total;
+    }
+
+    uint64_t SkippedIterations() const { return skippedIterations; }
+    uint64_t SkippedInstructions() const { return skippedInstructions; }
+    uint64_t Mismatches() const { return mismatches; }
+    const std::string& LastMismatch() const { return lastMismatch; }
+
+private:
+    // Symbolic 4-bit value: (header value of `base` + off) & 0xF.
+    enum : int8_t { BASE_CONST = -1, BASE_ACC = 16 };
+    struct Sym {
+        int8_t base;
+        uint8_t off;
+    };
+
+    // How a flag was last set: a comparison of symbolic values, or left over from the header.
+    enum FlagKind : uint8_t { FLAG_LIVE_IN, FLAG_ZERO, FLAG_ADD_CARRY, FLAG_SUB_BORROW };
+    struct Flag {
+        FlagKind kind;
+        Sym a, b;
+    };
+
+    struct Branch {
+        bool onZ;   // JZ (true) or JC (false)
+        bool taken; // direction in the analysed iteration
+        Flag cond;
+    };
+
+    // One iteration of the loop body in symbolic form.
+    struct Body {
+        std::array<Sym, 16> cells; // RAM at the end of the iteration
+        Sym acc;
+        Flag z, c;
+        uint16_t written;          // cells stored to
+        uint16_t liveIn;           // cells whose header value is read
+        bool accLiveIn;            // header ACC is read
+        uint8_t lastPC;            // the jump back to the header
+    };
+
+    std::array<uint64_t, 4> headers = {}; // targets of backward jumps in the ROM
+    std::array<uint64_t, 4> failed = {};  // headers whose loop did not qualify, untrapped
+    bool retrying = false;                // `failed` is set; cleared RETRY_INTERVAL later
+    uint64_t sinceFailure = 0;
+    uint32_t romVersion = 0;
+    uint64_t installedDispatch = 0;       // CPU4bit::dispatchVersion right after installing the traps
+    uint64_t skippedIterations = 0;
+    uint64_t skippedInstructions = 0;
+    uint64_t mismatches = 0;
+    std::string lastMismatch;
+    CPU4bit reference; // interpreter replay for crossCheck
+
+    // Analysis of the loop at the current header.
+    std::array<uint8_t, 17> header;     // RAM 0-15 and ACC at the header of iteration 0
+    std::array<uint8_t, 17> step;       // per-iteration increment of a base the body reads
+    std::array<bool, 17> isConst;       // base is overwritten with constValue every iteration
+    std::array<uint8_t, 17> constValue;
+    bool headerZ = false, headerC = false;
+    Flag endZ, endC;
+    std::array<Branch, MAX_BODY> branches;
+    int branchCount = 0;
+
+    // Every target of a JMP/JZ/JC at or before the jump. Operand bytes decode as instructions
+    // too, so a few headers may be bogus; their analysis fails and they lose their trap.
+    void FindHeaders(const CPU4bit& cpu){
+        headers = {};
+        for (int pc = 0; pc < 256; ++pc)
+        {
+            const Decode::DecodedOp& op = cpu.decoded[pc];
+            bool jump = (op.handler == Decode::OP_JMP || op.handler == Decode::OP_JZ || op.handler == Decode::OP_JC);
+            if (jump && op.target <= pc) headers[op.target >> 6] |= 1ull << (op.target & 63);
+        }
+        failed = {};
+        retrying = false;
+        romVersion = cpu.romVersion;
+    }
+
+    void InstallTraps(CPU4bit& cpu){
+        std::array<uint64_t, 4> traps;
+        for (int word = 0; word < 4; ++word) traps[word] = headers[word] & ~failed[word];
+        cpu.SetTraps(traps);
+        installedDispatch = cpu.dispatchVersion;
+    }
+
+    void Fail(uint8_t start){
+        failed[start >> 6] |= 1ull << (start & 63);
+        installedDispatch = 0;
+        if (!retrying) {
+            retrying = true;
+            sinceFailure = 0;
+        }
+    }
+
+    static Sym Const(uint8_t v){ return Sym{ BASE_CONST, (uint8_t)(v & 0xF) }; }
+
+    uint8_t BaseValue(int8_t base, uint64_t k) const {
+        if (base == BASE_CONST) return 0;
+        if (isConst[base]) return (k == 0) ? header[base] : constValue[base];
+        return (uint8_t)((header[base] + (k & 0xF) * step[base]) & 0xF);
+    }
+
+    uint8_t Eval(Sym s, uint64_t k) const { return (uint8_t)((BaseValue(s.base, k) + s.off) & 0xF); }
+
+    // Value of a flag after the instructions it depends on, in iteration k.
+    bool EvalFlag(const Flag& f, bool isZ, uint64_t k) const {
+        switch (f.kind)
+        {
+        case FLAG_ZERO:       return Eval(f.a, k) == 0;
+        case FLAG_ADD_CARRY:  return Eval(f.a, k) + Eval(f.b, k) > 15;
+        case FLAG_SUB_BORROW: return Eval(f.a, k) < Eval(f.b, k);
+        default:
+            {
+                // Carried over from the end of the previous iteration.
+                const Flag& end = isZ ? endZ : endC;
+                if (k == 0 || end.kind == FLAG_LIVE_IN) return isZ ? headerZ : headerC;
+                return EvalFlag(end, isZ, k - 1);
+            }
+        }
+    }
+
+    bool PathHolds(uint64_t k) const {
+        for (int i = 0; i < branchCount; ++i)
+        {
+            if (EvalFlag(branches[i].cond, branches[i].onZ, k) != branches[i].taken) return false;
+        }
+        return true;
+    }
+
+    // Walks one iteration from cpu.PC. Cells in `invariant` are taken as constants.
+    // Returns the body length, or 0 if the body leaves the supported subset.
+    int Walk(const CPU4bit& cpu, uint16_t invariant, Body& body){
+        const uint8_t start = cpu.PC;
+        for (int i = 0; i < 16; ++i) body.cells[i] = (invariant & (1u << i)) ? Const(header[i]) : Sym{ (int8_t)i, 0 };
+        body.acc = Sym{ BASE_ACC, 0 };
+        body.z = Flag{ FLAG_LIVE_IN, {}, {} };
+        body.c = Flag{ FLAG_LIVE_IN, {}, {} };
+        body.written = 0;
+        body.liveIn = 0;
+        body.accLiveIn = false;
+        branchCount = 0;
+
+        uint8_t pc = start;
+        int length = 0;
+        auto read = [&body](Sym s){
+            if (s.base == BASE_ACC) body.accLiveIn = true;
+            else if (s.base != BASE_CONST) body.liveIn |= (uint16_t)(1u << s.base);
+            return s;
+        };
+        do
+        {
+            if (length == MAX_BODY) return 0;
+            const Decode::DecodedOp op = cpu.decoded[pc];
+            body.lastPC = pc;
+            length++;
+            switch (op.handler)
+            {
+            case Decode::OP_NOP:
+                pc++;
+                break;
+            case Decode::OP_LDA:
+                body.acc = read(body.cells[op.operand]);
+                body.z = Flag{ FLAG_ZERO, body.acc, {} };
+                pc++;
+                break;
+            case Decode::OP_LDI:
+                body.acc = Const(op.operand);
+                body.z = Flag{ FLAG_ZERO, body.acc, {} };
+                pc++;
+                break;
+            case Decode::OP_STA:
+                body.cells[op.operand] = read(body.acc);
+                body.written |= (uint16_t)(1u << op.operand);
+                pc++;
+                break;
+            case Decode::OP_ADD:
+            case Decode::OP_SUB:
+                {
+                    Sym a = read(body.acc), b = read(body.cells[op.operand]);
+                    bool add = (op.handler == Decode::OP_ADD);
+                    if (b.base == BASE_CONST) {
+                        body.acc = Sym{ a.base, (uint8_t)((add ? a.off + b.off : a.off - b.off) & 0xF) };
+                    } else if (add && a.base == BASE_CONST) {
+                        body.acc = Sym{ b.base, (uint8_t)((a.off + b.off) & 0xF) };
+                    } else if (!add && a.base == b.base) {
+                        body.acc = Const((uint8_t)(a.off - b.off)); // x - x: the base cancels out
+                    } else {
+                        return 0; // sum of two moving values is not a fixed step
+                    }
+                    body.c = Flag{ add ? FLAG_ADD_CARRY : FLAG_SUB_BORROW, a, b };
+                    body.z = Flag{ FLAG_ZERO, body.acc, {} };
+                    pc++;
+                }
+                break;
+            case Decode::OP_JMP:
+                pc = op.target;
+                break;
+            case Decode::OP_JZ:
+            case Decode::OP_JC:
+                {
+                    Branch& br = branches[branchCount++];
+                    br.onZ = (op.handler == Decode::OP_JZ);
+                    br.cond = br.onZ ? body.z : body.c;
+                    br.taken = EvalFlag(br.cond, br.onZ, 0);
+                    pc = br.taken ? op.target : (uint8_t)(pc + 2);
+                }
+                break;
+            default:
+                return 0; // input, output (LED port, devices, OUT), stack, indirect or logic ops
+            }
+        } while (pc != start);
+        return length;
+    }
+
+    // Analyses the loop at cpu.PC. Returns the body length, or 0 if the loop does not qualify.
+    int Analyse(const CPU4bit& cpu, Body& body){
+        for (uint8_t i = 0; i < 16; ++i) header[i] = cpu.ReadRAM(i);
+        header[BASE_ACC] = cpu.ACC;
+        for (uint8_t v : header) if (v > 15) return 0; // STAI/POP leftovers: not 4-bit arithmetic
+        headerZ = cpu.Z;
+        headerC = cpu.C;
+        step.fill(0);
+        isConst.fill(false);
+
+        // First pass with every cell constant: the path of iteration 0 and the cells it writes.
+        // Cells the body never writes keep their value in every iteration.
+        if (Walk(cpu, 0xFFFF, body) == 0) return 0;
+        int length = Walk(cpu, (uint16_t)~body.written, body);
+        if (length == 0) return 0;
+
+        // Every value the body reads from the header must advance by a fixed step (or be
+        // overwritten with a constant) from one iteration to the next.
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!(body.liveIn & (1u << i))) continue;
+            if (body.cells[i].base == BASE_CONST) { isConst[i] = true; constValue[i] = body.cells[i].off; }
+            else if (body.cells[i].base == i) step[i] = body.cells[i].off;
+            else return 0;
+        }
+        if (body.accLiveIn) {
+            if (body.acc.base == BASE_CONST) { isConst[BASE_ACC] = true; constValue[BASE_ACC] = body.acc.off; }
+            else if (body.acc.base == BASE_ACC) step[BASE_ACC] = body.acc.off;
+            else return 0;
+        }
+        endZ = body.z;
+        endC = body.c;
+        return length;
+    }
+
+    uint64_t TrySkip(CPU4bit& cpu, uint64_t budget){
+        const uint8_t start = cpu.PC;
+        Body body;
+        int length = Analyse(cpu, body);
+        if (length == 0) { Fail(start); return 0; }
+
+        // Iterations 0..n-1 follow the analysed path. From iteration 1 on every value repeats
+        // with period 16 (and a carried-over flag from iteration 2 on), so a path that holds
+        // for k = 1..PROBES holds forever.
+        const uint64_t PROBES = 17;
+        uint64_t limit = budget / (uint64_t)length;
+        uint64_t n = 1;
+        while (n <= PROBES && n < limit && PathHolds(n)) n++;
+        if (n > PROBES) n = limit;
+        if (n < 2) { Fail(start); return 0; }
+
+        if (crossCheck) {
+            reference = cpu;
+            reference.SetOutputLog(nullptr);
+            reference.ClearTraps();
+        }
+
+        for (uint8_t i = 0; i < 16; ++i)
+        {
+            if (body.written & (1u << i)) cpu.WriteRAM(i, Eval(body.cells[i], n - 1));
+        }
+        cpu.ACC = Eval(body.acc, n - 1);
+        cpu.Z = EvalFlag(endZ, true, n - 1);
+        cpu.C = EvalFlag(endC, false, n - 1);
+        cpu.IR = cpu.ROM[body.lastPC];
+        cpu.PC = start;
+
+        uint64_t executed = n * (uint64_t)length;
+        if (crossCheck) {
+            reference.RunFor(executed);
+            if (std::memcmp(&reference.State(), &cpu.State(), sizeof(CPUState)) != 0) {
+                mismatches++;
+                lastMismatch = "loop at pc=" + std::to_string(start) + ": fast-forward of " + std::to_string(n) +
+                               " iterations differs from the interpreter";
+                cpu.State() = reference.State();
+                Fail(start);
+            }
+        }
+        skippedIterations += n;
+        skippedInstructions += executed;
+        return executed;
+    }
+};
+
+#endif
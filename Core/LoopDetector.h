@@ -0,0 +1,164 @@
+#ifndef LOOP_DETECTOR_H
+#define LOOP_DETECTOR_H
+
+// Proves non-termination by finding an exactly repeated machine state.
+//
+// Between two inputs the CPU is deterministic, so once the state that drives execution
+// (ACC, PC, SP, Z, C, RAM, STACK) repeats, the run loops forever. The state is tracked with
+// an incremental Zobrist hash (only the registers and the single cell an instruction writes
+// are rehashed) and cycles are found with Brent's algorithm: one saved checkpoint state,
+// moved every power-of-two steps, so memory stays constant however long the loop is.
+// A hash match is always confirmed by comparing the full state, so reports are exact.
+// IR, the GPIO latches and the console do not influence execution and are ignored.
+//
+// Use as a RunHooked() observer; the run stops with StopReason::Predicate when a loop is
+// found. Call Reset() whenever the state changes outside an instruction (ResolveInput); LDA 14
+// restarts the search by itself, so values from an input provider need nothing extra.
+
+#include <cstdint>
+#include "CPU.h"
+
+class LoopDetector : public NoHooks {
+public:
+    // Starts watching from the current state of `cpu`.
+    void Reset(const CPU4bit& cpu){
+        cellHash = 0;
+        for (int i = 0; i < 16; ++i) cellHash ^= Table().cells[i][cpu.ReadRAM((uint8_t)i)];
+        for (int i = 0; i < 16; ++i) cellHash ^= Table().cells[16 + i][cpu.STACK[i]];
+        SaveCheckpoint(cpu, Hash(cpu));
+        power = 1;
+        found = false;
+        pendingCell = NO_CELL;
+    }
+
+    bool Found() const { return found; }
+    uint64_t LoopLength() const { return loopLength; } // instructions per iteration
+    uint8_t LoopMinPC() const { return pcMin; }
+    uint8_t LoopMaxPC() const { return pcMax; }
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        switch (op.handler)
+        {
+        case Decode::OP_STA:
+        case Decode::OP_STA_DEV:
+            Pending(op.operand, cpu.ReadRAM(op.operand));
+            break;
+        case Decode::OP_STA_GPIO:
+            Pending(15, cpu.ReadRAM(15));
+            break;
+        case Decode::OP_STAI:
+            {
+                uint8_t addr = cpu.ReadRAM(op.operand) & 0xF;
+                Pending(addr, cpu.ReadRAM(addr));
+            }
+            break;
+        case Decode::OP_CALL:
+        case Decode::OP_PUSH:
+            if (cpu.SP < cpu.STACK.size()) Pending((uint8_t)(16 + cpu.SP), cpu.STACK[cpu.SP]);
+            break;
+        case Decode::OP_RST:
+        case Decode::OP_INPUT: // an input provider may deliver a value right away
+        case Decode::OP_LDA_DEV: // so may a device (timer, random source)
+            pendingCell = ALL_CELLS;
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool AfterExecute(const CPU4bit& cpu){
+        if (pendingCell != NO_CELL) {
+            if (pendingCell == ALL_CELLS) {
+                Reset(cpu); // RST rewrites RAM, an input starts a new deterministic stretch: restart the search
+                return false;
+            }
+            uint8_t now = (pendingCell < 16) ? cpu.ReadRAM(pendingCell) : cpu.STACK[pendingCell - 16];
+            cellHash ^= Table().cells[pendingCell][pendingOld] ^ Table().cells[pendingCell][now];
+            pendingCell = NO_CELL;
+        }
+
+        uint64_t hash = Hash(cpu);
+        sinceCheckpoint++;
+        if (cpu.PC < pcMin) pcMin = cpu.PC;
+        if (cpu.PC > pcMax) pcMax = cpu.PC;
+
+        if (hash == checkpointHash && SameExecutionState(cpu, checkpoint)) {
+            found = true;
+            loopLength = sinceCheckpoint;
+            return true;
+        }
+        if (sinceCheckpoint == power) {
+            SaveCheckpoint(cpu, hash);
+            power <<= 1;
+        }
+        return false;
+    }
+
+private:
+    static const uint8_t NO_CELL = 0xFF;
+    static const uint8_t ALL_CELLS = 0xFE;
+
+    // Random keys per (component, value); cells 0-15 are RAM, 16-31 STACK.
+    struct Keys {
+        uint64_t cells[32][256];
+        uint64_t acc[256];
+        uint64_t pc[256];
+        uint64_t sp[256];
+        uint64_t flags[4];
+
+        Keys(){
+            uint64_t seed = 0x9E3779B97F4A7C15ULL;
+            auto next = [&seed](){ // splitmix64
+                uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                return z ^ (z >> 31);
+            };
+            for (auto& cell : cells) for (uint64_t& k : cell) k = next();
+            for (uint64_t& k : acc) k = next();
+            for (uint64_t& k : pc) k = next();
+            for (uint64_t& k : sp) k = next();
+            for (uint64_t& k : flags) k = next();
+        }
+    };
+
+    static const Keys& Table(){
+        static const Keys keys;
+        return keys;
+    }
+
+    CPUState checkpoint;
+    uint64_t checkpointHash = 0;
+    uint64_t cellHash = 0;     // RAM + STACK part, maintained incrementally
+    uint64_t power = 1;
+    uint64_t sinceCheckpoint = 0;
+    uint64_t loopLength = 0;
+    uint8_t pcMin = 0, pcMax = 0;
+    uint8_t pendingCell = NO_CELL;
+    uint8_t pendingOld = 0;
+    bool found = false;
+
+    void Pending(uint8_t cell, uint8_t old){
+        pendingCell = cell;
+        pendingOld = old;
+    }
+
+    uint64_t Hash(const CPU4bit& cpu) const {
+        const Keys& k = Table();
+        return cellHash ^ k.acc[cpu.ACC] ^ k.pc[cpu.PC] ^ k.sp[cpu.SP] ^ k.flags[(cpu.Z ? 1 : 0) | (cpu.C ? 2 : 0)];
+    }
+
+    void SaveCheckpoint(const CPU4bit& cpu, uint64_t hash){
+        checkpoint = cpu.State();
+        checkpointHash = hash;
+        sinceCheckpoint = 0;
+        pcMin = pcMax = cpu.PC;
+    }
+
+    static bool SameExecutionState(const CPU4bit& cpu, const CPUState& s){
+        return cpu.ACC == s.ACC && cpu.PC == s.PC && cpu.SP == s.SP && cpu.Z == s.Z && cpu.C == s.C &&
+               cpu.RAM == s.RAM && cpu.STACK == s.STACK;
+    }
+};
+
+#endif
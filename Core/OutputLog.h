@@ -0,0 +1,101 @@
+#ifndef OUTPUT_LOG_H
+#define OUTPUT_LOG_H
+
+// Every OUT value, in order.
+//
+// CPUState's ConsoleRing only keeps the last 16 outputs (it has to fit the 64-byte state). A
+// CPU4bit with a log attached (SetOutputLog) also appends each raw OUT byte here. The log is
+// a ring that is allocated once, so appending never allocates. Positions are absolute: 0 is
+// the first OUT since LoadProgram(), Total() is one past the newest. A reader that keeps its
+// position sees each value exactly once, and Oldest() tells it whether it fell behind the
+// ring. Nothing is formatted here; the UI and tools turn values into text when they show them.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class OutputLog {
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+    // `capacity` is rounded up to a power of two.
+    explicit OutputLog(size_t capacity = DEFAULT_CAPACITY){
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        values.assign(size, 0);
+        mask = size - 1;
+    }
+
+    void Append(uint8_t value){
+        values[total & mask] = value;
+        total++;
+        if (total - oldest > values.size()) oldest = total - values.size();
+    }
+
+    // Takes back the newest value (STEP BACK over an OUT).
+    void Retract(){ if (total > oldest) total--; }
+
+    // Takes back everything from `position` on (STEP BACK over a whole-state entry).
+    void RetractTo(uint64_t position){ if (position < total) total = std::max(position, oldest); }
+
+    void Clear(){ total = oldest = 0; }
+
+    uint64_t Total() const { return total; }   // values appended since Clear()
+    uint64_t Oldest() const { return oldest; } // first position still held
+    size_t Capacity() const { return values.size(); }
+
+    // Value at absolute position `pos` (Oldest() <= pos < Total()).
+    uint8_t At(uint64_t pos) const { return values[pos & mask]; }
+
+    // Bulk read: copies up to `max` values starting at `from` (raised to Oldest() if the ring
+    // has moved past it) and returns how many were copied. `from` is updated to the position
+    // after the last value, ready for the next call.
+    size_t Read(uint64_t& from, uint8_t* out, size_t max) const {
+        if (from < oldest) from = oldest;
+        if (from >= total) return 0;
+        size_t n = (size_t)std::min<uint64_t>(total - from, max);
+        size_t start = (size_t)(from & mask);
+        size_t first = std::min(n, values.size() - start);
+        std::memcpy(out, values.data() + start, first);
+        std::memcpy(out + first, values.data(), n - first);
+        from += n;
+        return n;
+    }
+
+    // Everything still held, oldest first.
+    std::vector<uint8_t> Values() const {
+        std::vector<uint8_t> out((size_t)(total - oldest));
+        uint64_t from = oldest;
+        Read(from, out.data(), out.size());
+        return out;
+    }
+
+private:
+    std::vector<uint8_t> values;
+    size_t mask = 0;
+    uint64_t total = 0;
+    uint64_t oldest = 0;
+};
+
+// The newest WINDOW values of a log, as a plain value that can be copied between threads
+// (the simulation thread publishes one with every snapshot).
+struct OutputWindow {
+    static const size_t WINDOW = 256;
+
+    std::array<uint8_t, WINDOW> values = {}; // oldest first
+    uint64_t first = 0; // absolute position of values[0]
+    uint64_t total = 0; // first + Count()
+
+    size_t Count() const { return (size_t)(total - first); }
+
+    void CopyFrom(const OutputLog& log){
+        first = log.Total() - std::min<uint64_t>(log.Total() - log.Oldest(), WINDOW);
+        total = log.Total();
+        uint64_t from = first;
+        log.Read(from, values.data(), WINDOW);
+    }
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef PERIPHERAL_BUS_H
+#define PERIPHERAL_BUS_H
+
+// Memory-mapped devices for CPU4bit.
+//
+// Each RAM address can have one Peripheral attached (CPU4bit::AttachDevice). `LDA addr` then
+// loads from the device and `STA addr` writes to it, for the directions the device maps; the
+// cell itself keeps the last value transferred, the way RAM[14] and RAM[15] do for the built-in
+// ports. The table is resolved into the decode cache when a program is loaded or a device is
+// attached, so unmapped addresses keep their plain RAM handlers and no run-time lookup happens.
+// Without a device, 14 is the input port (InputProvider.h) and 15 the LED latch; attaching a
+// device there replaces them. ALU operands and LDAI/STAI always see the RAM cell.
+//
+// Devices are host objects like input providers: they are not part of CPUState, so snapshots,
+// undo and history restore the cell but never un-send a write or rewind a device.
+// Device reads always complete; a source that can run dry belongs in an InputProvider.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Peripherals.h"
+
+enum PeripheralAccess : uint8_t {
+    PERIPHERAL_READ = 1,  // LDA addr reads the device
+    PERIPHERAL_WRITE = 2  // STA addr writes the device
+};
+
+class Peripheral {
+public:
+    virtual ~Peripheral() = default;
+
+    // PERIPHERAL_READ / PERIPHERAL_WRITE bits; queried once when the device is attached.
+    virtual uint8_t Mapped() const = 0;
+
+    // LDA addr: the nibble to load (only the low 4 bits are used).
+    virtual uint8_t Read(uint8_t address){ (void)address; return 0; }
+
+    // STA addr: `value` is the accumulator.
+    virtual void Write(uint8_t address, uint8_t value){ (void)address; (void)value; }
+};
+
+// Dispatch table from RAM address to device, plus the read/write bitmasks the decoder uses.
+class PeripheralBus {
+public:
+    static const int PORTS = 16;
+
+    // Returns false for an address outside RAM. A null device detaches.
+    bool Attach(uint8_t address, Peripheral* device){
+        if (address >= PORTS) return false;
+        devices[address] = device;
+        uint16_t bit = (uint16_t)(1u << address);
+        uint8_t mapped = device ? device->Mapped() : 0;
+        readMask = (mapped & PERIPHERAL_READ) ? (readMask | bit) : (readMask & ~bit);
+        writeMask = (mapped & PERIPHERAL_WRITE) ? (writeMask | bit) : (writeMask & ~bit);
+        return true;
+    }
+
+    void DetachAll(){ devices.fill(nullptr); readMask = writeMask = 0; }
+
+    Peripheral* At(uint8_t address) const { return devices[address & 0xF]; }
+    uint16_t ReadMask() const { return readMask; }
+    uint16_t WriteMask() const { return writeMask; }
+    bool Any() const { return (readMask | writeMask) != 0; }
+
+    // Only called for addresses whose bit is set (the decoder guarantees it).
+    uint8_t Read(uint8_t address){ return devices[address & 0xF]->Read(address) & 0xF; }
+    void Write(uint8_t address, uint8_t value){ devices[address & 0xF]->Write(address, value); }
+
+private:
+    std::array<Peripheral*, PORTS> devices = {};
+    uint16_t readMask = 0;
+    uint16_t writeMask = 0;
+};
+
+// GPIO input side: reads the current switch positions without waiting for SEND.
+class SwitchPort : public Peripheral {
+public:
+    explicit SwitchPort(const GPIO_Unit& unit) : gpio(unit) {}
+
+    uint8_t Mapped() const override { return PERIPHERAL_READ; }
+    uint8_t Read(uint8_t) override { return gpio.getSwitches() & 0xF; }
+
+private:
+    const GPIO_Unit& gpio;
+};
+
+// Free-running host timer: reads return the number of elapsed periods (mod 16), a write
+// restarts it from 0.
+class TimerDevice : public Peripheral {
+public:
+    explicit TimerDevice(uint64_t periodMicros = 1000) : period(periodMicros ? periodMicros : 1) { Restart(); }
+
+    uint8_t Mapped() const override { return PERIPHERAL_READ | PERIPHERAL_WRITE; }
+
+    uint8_t Read(uint8_t) override {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        return (uint8_t)(((uint64_t)elapsed / period) & 0xF);
+    }
+
+    void Write(uint8_t, uint8_t) override { Restart(); }
+
+    void Restart(){ start = Clock::now(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    uint64_t period;
+    Clock::time_point start;
+};
+
+// Character terminal: two consecutive writes form one byte (high nibble first). Characters
+// are kept in Text() and, if a stream was given, printed as they complete.
+class ConsoleDevice : public Peripheral {
+public:
+    explicit ConsoleDevice(std::FILE* echo = nullptr) : out(echo) {}
+
+    uint8_t Mapped() const override { return PERIPHERAL_WRITE; }
+
+    void Write(uint8_t, uint8_t value) override {
+        if (!halfFull) {
+            high = value & 0xF;
+            halfFull = true;
+            return;
+        }
+        char ch = (char)(high << 4 | (value & 0xF));
+        halfFull = false;
+        text += ch;
+        if (out) std::fputc(ch, out);
+    }
+
+    const std::string& Text() const { return text; }
+    void Clear(){ text.clear(); halfFull = false; }
+
+private:
+    std::FILE* out;
+    std::string text;
+    uint8_t high = 0;
+    bool halfFull = false;
+};
+
+// Deterministic random nibbles (xorshift64*), reseeded by a write.
+class RandomDevice : public Peripheral {
+public:
+    explicit RandomDevice(uint64_t seed = 1) { Seed(seed); }
+
+    uint8_t Mapped() const override { return PERIPHERAL_READ | PERIPHERAL_WRITE; }
+
+    uint8_t Read(uint8_t) override {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint8_t)((state * 0x2545F4914F6CDD1DULL) >> 60);
+    }
+
+    void Write(uint8_t, uint8_t value) override { Seed(value); }
+
+    void Seed(uint64_t seed){ state = seed * 0x9E3779B97F4A7C15ULL + 1; }
+
+private:
+    uint64_t state = 1;
+};
+
+// Test harness port: records every write and answers reads with a settable value.
+class CaptureDevice : public Peripheral {
+public:
+    explicit CaptureDevice(uint8_t access = PERIPHERAL_WRITE) : mapped(access) {}
+
+    uint8_t Mapped() const override { return mapped; }
+    uint8_t Read(uint8_t) override { reads++; return readValue; }
+    void Write(uint8_t, uint8_t value) override { writes.push_back(value); }
+
+    void SetReadValue(uint8_t value){ readValue = value & 0xF; }
+    const std::vector<uint8_t>& Writes() const { return writes; }
+    uint64_t Reads() const { return reads; }
+    void Clear(){ writes.clear(); reads = 0; }
+
+private:
+    uint8_t mapped;
+    uint8_t readValue = 0;
+    uint64_t reads = 0;
+    std::vector<uint8_t> writes;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Per-address execution profile: how often each ROM address ran, which way every JZ/JC went,
+// and how often each RAM cell was read and written.
+//
+// Used as a RunHooked() observer, so profiling is chosen at compile time: code that runs with
+// NoHooks (RunFor, the threaded engine) contains no counting at all, and a profiled run pays
+// one inlined counter update per instruction.
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "CPU.h"
+
+class ExecutionProfile : public NoHooks {
+public:
+    std::array<uint64_t, 256> executions = {}; // by ROM address of the opcode
+    std::array<uint64_t, 256> taken = {};      // JZ/JC at that address jumped
+    std::array<uint64_t, 256> notTaken = {};   // JZ/JC at that address fell through
+    std::array<uint64_t, 16> reads = {};       // by RAM cell
+    std::array<uint64_t, 16> writes = {};
+
+    void Clear(){ *this = ExecutionProfile(); }
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        executions[cpu.PC]++;
+        switch (op.handler)
+        {
+        case Decode::OP_LDA:
+        case Decode::OP_ADD:
+        case Decode::OP_SUB:
+        case Decode::OP_AND:
+        case Decode::OP_OR:
+        case Decode::OP_XOR:
+            reads[op.operand]++;
+            break;
+        case Decode::OP_INPUT:
+            writes[14]++; // ResolveInput() stores the value in RAM[14]
+            break;
+        case Decode::OP_STA:
+        case Decode::OP_STA_GPIO:
+        case Decode::OP_STA_DEV:
+            writes[op.operand]++;
+            break;
+        case Decode::OP_LDA_DEV: // reads the device, then mirrors the value into the cell
+            reads[op.operand]++;
+            writes[op.operand]++;
+            break;
+        case Decode::OP_LDAI:
+            reads[op.operand]++;
+            reads[cpu.ReadRAM(op.operand) & 0xF]++;
+            break;
+        case Decode::OP_STAI:
+            reads[op.operand]++;
+            writes[cpu.ReadRAM(op.operand) & 0xF]++;
+            break;
+        case Decode::OP_JZ:
+            (cpu.Z ? taken : notTaken)[cpu.PC]++;
+            break;
+        case Decode::OP_JC:
+            (cpu.C ? taken : notTaken)[cpu.PC]++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint64_t MaxExecutions() const {
+        uint64_t m = 0;
+        for (uint64_t n : executions) if (n > m) m = n;
+        return m;
+    }
+
+    uint64_t MaxCellAccesses() const {
+        uint64_t m = 0;
+        for (int i = 0; i < 16; ++i) if (reads[i] + writes[i] > m) m = reads[i] + writes[i];
+        return m;
+    }
+
+    // One row per executed ROM address, then one row per RAM cell.
+    std::string ToCSV(const CPU4bit& cpu) const {
+        std::string out = "section,index,byte,executions,taken,not_taken,reads,writes\n";
+        for (int addr = 0; addr < 256; ++addr)
+        {
+            if (executions[addr] == 0) continue;
+            out += "rom," + std::to_string(addr) + "," + std::to_string(cpu.ROM[addr]) + "," +
+                   std::to_string(executions[addr]) + "," + std::to_string(taken[addr]) + "," +
+                   std::to_string(notTaken[addr]) + ",,\n";
+        }
+        for (int cell = 0; cell < 16; ++cell)
+        {
+            out += "ram," + std::to_string(cell) + ",,,,," + std::to_string(reads[cell]) + "," +
+                   std::to_string(writes[cell]) + "\n";
+        }
+        return out;
+    }
+
+    std::string ToJSON(const CPU4bit& cpu) const {
+        std::string out = "{\n  \"rom\": [";
+        bool first = true;
+        for (int addr = 0; addr < 256; ++addr)
+        {
+            if (executions[addr] == 0) continue;
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += "    {\"address\": " + std::to_string(addr) + ", \"byte\": " + std::to_string(cpu.ROM[addr]) +
+                   ", \"executions\": " + std::to_string(executions[addr]);
+            if (taken[addr] + notTaken[addr] != 0) {
+                out += ", \"taken\": " + std::to_string(taken[addr]) + ", \"not_taken\": " + std::to_string(notTaken[addr]);
+            }
+            out += "}";
+        }
+        out += "\n  ],\n  \"ram\": [";
+        for (int cell = 0; cell < 16; ++cell)
+        {
+            out += (cell == 0) ? "\n" : ",\n";
+            out += "    {\"cell\": " + std::to_string(cell) + ", \"reads\": " + std::to_string(reads[cell]) +
+                   ", \"writes\": " + std::to_string(writes[cell]) + "}";
+        }
+        return out + "\n  ]\n}\n";
+    }
+};
+
+// Runs like CPU4bit::RunFor() and counts every executed instruction into `profile`.
+inline RunResult RunProfiled(CPU4bit& cpu, ExecutionProfile& profile, uint64_t budget){
+    return cpu.RunHooked(profile, budget);
+}
+
+#endif
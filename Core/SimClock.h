@@ -0,0 +1,106 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+// Simulated CPU clock, independent of the render frame rate.
+//
+// Each frame the caller passes the elapsed frame time; the clock adds rate * dt to an
+// instruction accumulator and executes the whole part of it through RunFor(), so a 1 Hz
+// clock runs one instruction per second and a 1 MHz clock ~16700 per 60 FPS frame.
+// "Unlimited" and turbo run for a fixed slice of wall time per frame instead.
+
+#include <chrono>
+#include <cstdint>
+#include "CPU.h"
+
+class SimClock {
+public:
+    // Selectable target rates in Hz; 0 means unlimited.
+    static constexpr int RATE_COUNT = 10;
+    static constexpr double RATES[RATE_COUNT] = { 1, 2, 5, 10, 100, 1e3, 1e4, 1e5, 1e6, 0 };
+
+    static constexpr double MAX_BACKLOG_SECONDS = 0.25; // after a stall, catch up at most this much
+    static constexpr double UNLIMITED_SLICE_SECONDS = 0.010; // leaves headroom in a 16.7 ms frame
+    static constexpr uint64_t UNLIMITED_CHUNK = 1 << 16; // instructions between wall-clock checks
+    static constexpr double MEASURE_WINDOW_SECONDS = 0.5;
+
+    int rateIndex = 3; // 10 Hz, the old fixed 100 ms step
+    bool turbo = false; // run until HLT/input as fast as possible, UI shows only the final state
+
+    double TargetRate() const { return RATES[rateIndex]; }
+    bool IsUnlimited() const { return turbo || TargetRate() == 0; }
+    void Faster(){ if (rateIndex < RATE_COUNT - 1) { rateIndex++; accumulator = 0; } }
+    void Slower(){ if (rateIndex > 0) { rateIndex--; accumulator = 0; } }
+
+    // Achieved simulated frequency (instructions per second of wall time) over the last window.
+    double AchievedRate() const { return achievedRate; }
+
+    // Drops owed instructions and the measurement, e.g. when the run is paused or the CPU reset.
+    void Stop(){
+        accumulator = 0;
+        windowInstructions = 0;
+        windowSeconds = 0;
+        achievedRate = 0;
+    }
+
+    // Advances the CPU by one frame worth of simulated time.
+    RunResult RunFrame(CPU4bit& cpu, double frameSeconds){
+        return RunFrame(cpu, frameSeconds, [](CPU4bit& c, uint64_t budget){ return c.RunFor(budget); });
+    }
+
+    // Same, executing through `run(cpu, budget) -> RunResult` (e.g. a journaling run).
+    template <class RunFn>
+    RunResult RunFrame(CPU4bit& cpu, double frameSeconds, RunFn run){
+        RunResult result;
+        if (IsUnlimited()) {
+            result = RunSlice(cpu, run);
+        } else {
+            accumulator += TargetRate() * frameSeconds;
+            double backlog = TargetRate() * MAX_BACKLOG_SECONDS;
+            if (backlog < 1.0) backlog = 1.0;
+            if (accumulator > backlog) accumulator = backlog;
+            uint64_t owed = (uint64_t)accumulator;
+            result = run(cpu, owed);
+            accumulator -= (double)result.executed;
+            if (result.reason != StopReason::Budget) accumulator = 0; // stopped early: owe nothing
+        }
+        Record(result.executed, frameSeconds);
+        return result;
+    }
+
+private:
+    double accumulator = 0;
+    uint64_t windowInstructions = 0;
+    double windowSeconds = 0;
+    double achievedRate = 0;
+
+    template <class RunFn>
+    RunResult RunSlice(CPU4bit& cpu, RunFn& run){
+        RunResult total;
+        auto start = std::chrono::steady_clock::now();
+        while (true)
+        {
+            RunResult chunk = run(cpu, UNLIMITED_CHUNK);
+            total.executed += chunk.executed;
+            total.reason = chunk.reason;
+            if (chunk.reason != StopReason::Budget) break;
+            std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+            if (spent.count() >= UNLIMITED_SLICE_SECONDS) break;
+        }
+        return total;
+    }
+
+    void Record(uint64_t executed, double frameSeconds){
+        windowInstructions += executed;
+        windowSeconds += frameSeconds;
+        // Slow clocks need a longer window to see a few instructions per measurement
+        double window = MEASURE_WINDOW_SECONDS;
+        if (!IsUnlimited() && 4.0 / TargetRate() > window) window = 4.0 / TargetRate();
+        if (windowSeconds >= window) {
+            achievedRate = windowInstructions / windowSeconds;
+            windowInstructions = 0;
+            windowSeconds = 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+// Runs the CPU on its own thread so execution never waits for the renderer (or vsync).
+//
+// The UI talks to it through two wait-free channels:
+//   commands  : SpscQueue<SimCommand>   UI -> sim (step, run, pause, reset, input, clock, load)
+//   snapshots : TripleBuffer<SimSnapshot> sim -> UI (latest complete CPU state, never torn)
+// The UI keeps its own CPU4bit holding the ROM it loaded and copies each snapshot's
+// CPUState into it, so the existing Draw* functions keep working on a plain CPU4bit.
+// Every step, input and reset goes through an UndoJournal, so the UI can step back. RUN uses
+// the fast engine and leaves one whole-state entry where it started, so STEP BACK after a run
+// returns to that point; with journaling switched on ([J]) runs record every instruction too.
+// Keyboard digits and the input popup feed the CPU's FIFO input provider on this thread.
+// Every OUT goes to an OutputLog here; snapshots carry its newest values for the history panel.
+// While profiling is switched on, runs also count into an ExecutionProfile that is published
+// with every snapshot. Breakpoints join the observer set the same way, only while at least one
+// is set; without the journal or the profiler they trap into the fast engine instead
+// (Breakpoints::Run()), and with no observer at all a run is a plain RunFor().
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "CPU.h"
+#include "LockFree.h"
+#include "SimClock.h"
+#include "UndoJournal.h"
+#include "Profiler.h"
+#include "Breakpoints.h"
+
+enum SimCommandType : uint8_t {
+    SIM_LOAD,            // rom/ram/programId: load a program and pause
+    SIM_STEP,            // pause and execute one instruction
+    SIM_TOGGLE_RUN,      // RUN <-> PAUSE
+    SIM_PAUSE,
+    SIM_RESET,           // CPU Reset() and pause
+    SIM_INPUT,           // input `value` for the waiting LDA 14 (keyboard digit or popup SEND)
+    SIM_TOGGLE_SWITCH,   // GPIO switch `value`
+    SIM_FASTER,
+    SIM_SLOWER,
+    SIM_TOGGLE_TURBO,
+    SIM_STEP_BACK,       // pause and undo one journaled step
+    SIM_REVERSE_TO_WRITE, // pause and run backwards to the last write of RAM[value]; no-op if none is journaled
+    SIM_TOGGLE_PROFILE,   // start (with cleared counters) or stop the execution profile
+    SIM_SET_BREAKPOINTS,  // replace the breakpoint/watchpoint set with `breakpoints`
+    SIM_TOGGLE_JOURNAL    // journal every instruction of a run (slower) or only run starts
+};
+
+struct SimCommand {
+    SimCommandType type = SIM_PAUSE;
+    int value = 0;
+    uint32_t programId = 0;
+    std::array<uint8_t, 256> rom = {};
+    std::array<uint8_t, 16> ram = {};
+    Breakpoints breakpoints;
+};
+
+// Everything the simulation screen draws, published as one immutable value.
+struct SimSnapshot {
+    CPUState state;
+    uint32_t programId = 0;   // program the state belongs to (see SimThread::LoadProgram)
+    bool running = false;
+    bool turbo = false;
+    int rateIndex = 0;
+    double achievedRate = 0;
+    uint64_t runExecuted = 0; // instructions since RUN was pressed
+    uint64_t undoDepth = 0;   // steps STEP BACK can undo
+    bool journaling = false;  // runs are journaled instruction by instruction
+    bool profiling = false;
+    ExecutionProfile profile; // only updated while profiling
+    BreakHit breakHit;        // why the last run or step stopped early, if it hit one
+    OutputWindow outputs;     // newest OUT values of the current program
+    int noEarlierWrite = -1;  // RAM cell the last reverse-to-write found no journaled write for, else -1
+};
+
+class SimThread {
+public:
+    static constexpr double IDLE_SLEEP_SECONDS = 0.001;
+
+    SimThread(){
+        cpu.SetInputProvider(&input);
+        cpu.SetOutputLog(&outputs);
+    }
+    SimThread(const SimThread&) = delete;
+    SimThread& operator=(const SimThread&) = delete;
+    ~SimThread(){ Stop(); }
+
+    void Start(){
+        if (worker.joinable()) return;
+        quit = false;
+        worker = std::thread([this]{ Main(); });
+    }
+
+    void Stop(){
+        quit = true;
+        if (worker.joinable()) worker.join();
+    }
+
+    // UI thread. Returns false if the queue is full (the command is dropped).
+    bool Send(SimCommandType type, int value = 0){
+        SimCommand cmd;
+        cmd.type = type;
+        cmd.value = value;
+        return commands.Push(cmd);
+    }
+
+    // UI thread. The UI owns the breakpoint set and sends a copy whenever it changes.
+    bool SetBreakpoints(const Breakpoints& set){
+        SimCommand cmd;
+        cmd.type = SIM_SET_BREAKPOINTS;
+        cmd.breakpoints = set;
+        return commands.Push(cmd);
+    }
+
+    // UI thread. Returns the id that snapshots of this program will carry.
+    uint32_t LoadProgram(const std::vector<uint8_t>& code, const std::map<int, uint8_t>& data){
+        SimCommand cmd;
+        cmd.type = SIM_LOAD;
+        cmd.programId = ++lastProgramId;
+        for (size_t i = 0; i < code.size() && i < cmd.rom.size(); ++i) cmd.rom[i] = code[i];
+        for (auto const& [addr, val] : data)
+        {
+            if (addr >= 0 && addr < (int)cmd.ram.size()) cmd.ram[addr] = val;
+        }
+        commands.Push(cmd);
+        return cmd.programId;
+    }
+
+    // UI thread: picks up the newest snapshot, if any. Latest() is valid either way.
+    bool Update(){ return snapshots.Update(); }
+    const SimSnapshot& Latest() const { return snapshots.Front(); }
+
+private:
+    CPU4bit cpu{ExecEngine::Threaded};
+    SimClock clock;
+    UndoJournal journal;
+    ExecutionProfile profile;
+    Breakpoints breakpoints;
+    FifoInput input;
+    OutputLog outputs;
+    bool profiling = false;
+    bool journaling = false;
+    bool checkpointed = false; // the journal holds the state the current unjournaled run started from
+    bool running = false;
+    uint32_t programId = 0;
+    uint64_t runExecuted = 0;
+    int noEarlierWrite = -1;
+
+    SpscQueue<SimCommand, 64> commands;
+    TripleBuffer<SimSnapshot> snapshots;
+    uint32_t lastProgramId = 0; // UI side
+    std::atomic<bool> quit{false};
+    std::thread worker;
+
+    void Apply(const SimCommand& cmd){
+        if (cmd.type != SIM_REVERSE_TO_WRITE) noEarlierWrite = -1;
+        checkpointed = false;
+        switch (cmd.type)
+        {
+        case SIM_LOAD:
+            {
+                std::vector<uint8_t> code(cmd.rom.begin(), cmd.rom.end());
+                std::map<int, uint8_t> data;
+                for (int i = 0; i < (int)cmd.ram.size(); ++i) data[i] = cmd.ram[i];
+                cpu.LoadProgram(code, data);
+                cpu.SetConsoleEvent(CONSOLE_COMPILED);
+                journal.Clear();
+                breakpoints.ClearHit();
+                programId = cmd.programId;
+                running = false;
+            }
+            break;
+        case SIM_STEP:
+            running = false;
+            breakpoints.ClearHit();
+            Execute(cpu, 1, true);
+            break;
+        case SIM_TOGGLE_RUN:
+            running = !running;
+            if (running) breakpoints.ClearHit();
+            break;
+        case SIM_PAUSE:
+            running = false;
+            break;
+        case SIM_RESET:
+            journal.RecordFull(cpu);
+            cpu.Reset();
+            breakpoints.ClearHit();
+            running = false;
+            break;
+        case SIM_INPUT:
+            if (cpu.isWaitingForInput) {
+                journal.RecordFull(cpu);
+                input.Push((uint8_t)cmd.value);
+                if (cpu.PollInput() && breakpoints.InputDelivered()) running = false;
+            }
+            break;
+        case SIM_TOGGLE_SWITCH:
+            cpu.getGPIO().ToggleSwitch(cmd.value);
+            break;
+        case SIM_FASTER:
+            clock.Faster();
+            break;
+        case SIM_SLOWER:
+            clock.Slower();
+            break;
+        case SIM_TOGGLE_TURBO:
+            clock.turbo = !clock.turbo;
+            break;
+        case SIM_STEP_BACK:
+            running = false;
+            journal.StepBack(cpu);
+            break;
+        case SIM_REVERSE_TO_WRITE:
+            {
+                bool found = false;
+                journal.ReverseToWrite(cpu, (uint8_t)cmd.value, found);
+                if (found) running = false;
+                noEarlierWrite = found ? -1 : (cmd.value & 0xF);
+            }
+            break;
+        case SIM_TOGGLE_PROFILE:
+            profiling = !profiling;
+            if (profiling) profile.Clear();
+            break;
+        case SIM_SET_BREAKPOINTS:
+            breakpoints = cmd.breakpoints;
+            break;
+        case SIM_TOGGLE_JOURNAL:
+            journaling = !journaling;
+            break;
+        }
+    }
+
+    // The observer set is picked once per run slice, never per instruction. An unjournaled
+    // slice first leaves a whole-state entry, once per run, so STEP BACK lands where it started.
+    RunResult Execute(CPU4bit& c, uint64_t budget, bool journaled){
+        if (journaled) {
+            if (!profiling) return RunChecked(c, journal, budget);
+            HookPair<UndoJournal, ExecutionProfile> hooks(journal, profile);
+            return RunChecked(c, hooks, budget);
+        }
+        if (!checkpointed) { journal.RecordFull(c); checkpointed = true; }
+        if (profiling) return RunChecked(c, profile, budget);
+        if (breakpoints.Any()) return breakpoints.Run(c, budget);
+        c.ClearTraps();
+        return c.RunFor(budget);
+    }
+
+    template <class Hooks>
+    RunResult RunChecked(CPU4bit& c, Hooks& hooks, uint64_t budget){
+        if (!breakpoints.Any()) return c.RunHooked(hooks, budget);
+        HookPair<Hooks, Breakpoints> checked(hooks, breakpoints);
+        return c.RunHooked(checked, budget);
+    }
+
+    void Publish(){
+        SimSnapshot& snap = snapshots.Back();
+        snap.state = cpu.State();
+        snap.programId = programId;
+        snap.running = running;
+        snap.turbo = clock.turbo;
+        snap.rateIndex = clock.rateIndex;
+        snap.achievedRate = clock.AchievedRate();
+        snap.runExecuted = runExecuted;
+        snap.undoDepth = journal.Depth();
+        snap.journaling = journaling;
+        snap.profiling = profiling;
+        if (profiling) snap.profile = profile;
+        snap.breakHit = breakpoints.Hit();
+        snap.outputs.CopyFrom(outputs);
+        snap.noEarlierWrite = noEarlierWrite;
+        snapshots.Publish();
+    }
+
+    void Main(){
+        auto last = std::chrono::steady_clock::now();
+        Publish();
+        while (!quit.load(std::memory_order_relaxed))
+        {
+            bool changed = false;
+            SimCommand cmd;
+            while (commands.Pop(cmd)) { Apply(cmd); changed = true; }
+
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::duration<double> dt = now - last;
+            last = now;
+
+            if (running && !cpu.isWaitingForInput) {
+                RunResult run = clock.RunFrame(cpu, dt.count(),
+                    [this](CPU4bit& c, uint64_t budget){ return Execute(c, budget, journaling); });
+                runExecuted += run.executed;
+                if (run.reason == StopReason::Halted || run.reason == StopReason::Predicate) running = false;
+                changed = true;
+            }
+            if (!running) {
+                clock.Stop();
+                if (runExecuted != 0) { runExecuted = 0; changed = true; }
+            }
+            if (changed) Publish();
+
+            // Unlimited clocks keep the core busy; everything else polls for commands at ~1 kHz.
+            if (!running || cpu.isWaitingForInput || !clock.IsUnlimited())
+                std::this_thread::sleep_for(std::chrono::duration<double>(IDLE_SLEEP_SECONDS));
+        }
+    }
+};
+
+#endif
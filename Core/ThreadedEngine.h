@@ -0,0 +1,212 @@
+#ifndef THREADED_ENGINE_H
+#define THREADED_ENGINE_H
+
+// Direct-threaded interpreter core for CPU4bit (included from CPU.h).
+// Each handler jumps straight to the next handler through a label table instead of
+// returning to a central switch. Registers live in locals for the whole run and are
+// written back on exit, so byte stores into RAM/STACK cannot force them to be reloaded.
+// With CPU4BIT_PACKED_RAM the whole data memory is one more local (a uint64_t register).
+// RunFor() dispatches on `dispatch` with NoRecorder; RunRecorded() on the decode cache (no
+// traps) with a recorder called from the dispatch step, where the locals are the registers.
+
+#include <type_traits>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU4BIT_COMPUTED_GOTO 1
+#else
+#define CPU4BIT_COMPUTED_GOTO 0
+#endif
+
+template <class Recorder>
+inline uint64_t CPU4bit::RunThreadedOn(const Decode::DecodedOp* table, Recorder& recorder, uint64_t budget){
+#if !CPU4BIT_COMPUTED_GOTO
+    // Portable fallback: the switch loop over `table`
+    uint64_t executed = 0;
+    while (executed < budget)
+    {
+        const Decode::DecodedOp op = table[PC];
+        if (op.handler == Decode::OP_TRAP) { trapStop = true; break; }
+        recorder.Record(op, PC, ACC, SP, [this](uint8_t addr){ return ReadRAM(addr); });
+        IR = ROM[PC];
+        PC++;
+        ExecuteDecoded(op);
+        executed++;
+        if (halted || isWaitingForInput || outputStop) break;
+    }
+    return executed;
+#else
+    // Order must match Decode::Handler
+    static void* const LABELS[Decode::OP_COUNT] = {
+        &&op_nop, &&op_lda, &&op_input, &&op_ldi, &&op_sta, &&op_sta_gpio,
+        &&op_add, &&op_sub, &&op_and, &&op_or, &&op_xor, &&op_ldai, &&op_stai,
+        &&op_jmp, &&op_jz, &&op_jc, &&op_call,
+        &&op_hlt, &&op_rst, &&op_out, &&op_not, &&op_push, &&op_pop, &&op_ret,
+        &&op_lda_dev, &&op_sta_dev, &&op_trap
+    };
+
+    const Decode::DecodedOp* dec = table;
+    const uint8_t* rom = ROM.data();
+#ifdef CPU4BIT_PACKED_RAM
+    uint64_t ram = RAM.bits;
+#define RAM_READ(addr) Nibble::Get(ram, (addr))
+#define RAM_WRITE(addr, value) (ram = Nibble::Set(ram, (addr), (value)))
+#define RAM_SYNC_OUT() (RAM.bits = ram)
+#define RAM_SYNC_IN() (ram = RAM.bits)
+#else
+    uint8_t* ram = RAM.data();
+#define RAM_READ(addr) ram[(addr)]
+#define RAM_WRITE(addr, value) (ram[(addr)] = (value))
+#define RAM_SYNC_OUT() ((void)0)
+#define RAM_SYNC_IN() ((void)0)
+#endif
+    auto readRAM = [&](uint8_t addr){ return (uint8_t)RAM_READ(addr); };
+    uint8_t* stack = STACK.data();
+    const size_t stackSize = STACK.size();
+
+    Recorder rec = recorder; // a local copy stays in registers; written back on exit
+    uint8_t pc = PC, acc = ACC, sp = SP, ir = IR, lastIr = IR;
+    bool z = Z, c = C;
+    uint64_t executed = 0;
+    Decode::DecodedOp op;
+
+    // A recorder is called from one shared dispatch step instead of being inlined into every
+    // handler's; without one the condition folds away.
+    const bool recording = !std::is_same<Recorder, NoRecorder>::value;
+
+#define THREADED_DISPATCH() \
+    do { \
+        if (recording) goto record; \
+        if (executed == budget) goto done; \
+        op = dec[pc]; lastIr = ir; ir = rom[pc]; pc++; executed++; \
+        goto *LABELS[op.handler]; \
+    } while (0)
+
+    THREADED_DISPATCH();
+
+record:
+    if (executed == budget) goto done;
+    op = dec[pc];
+    rec.Record(op, pc, acc, sp, readRAM);
+    lastIr = ir; ir = rom[pc]; pc++; executed++;
+    goto *LABELS[op.handler];
+
+op_nop:
+    THREADED_DISPATCH();
+op_lda:
+    acc = RAM_READ(op.operand); z = (acc == 0);
+    THREADED_DISPATCH();
+op_input:
+    if (inputProvider) {
+        uint8_t value;
+        if (inputProvider->NextInput(value)) {
+            acc = value & 0xF; RAM_WRITE(14, acc); z = (acc == 0);
+            SetConsoleEvent(CONSOLE_INPUT, value);
+            THREADED_DISPATCH();
+        }
+    }
+    isWaitingForInput = true;
+    goto done;
+op_ldi:
+    acc = op.operand; z = (acc == 0);
+    THREADED_DISPATCH();
+op_sta:
+    RAM_WRITE(op.operand, acc & 0xF);
+    THREADED_DISPATCH();
+op_sta_gpio:
+    gpio.WriteOutputPort(acc);
+    RAM_WRITE(15, acc & 0xF);
+    if (breakOnOutput) { outputStop = true; goto done; }
+    THREADED_DISPATCH();
+op_add:
+    {
+        uint16_t temp = acc + RAM_READ(op.operand);
+        c = (temp > 15); acc = temp & 0xF; z = (acc == 0);
+    }
+    THREADED_DISPATCH();
+op_sub:
+    {
+        int temp = acc - RAM_READ(op.operand);
+        c = (temp < 0); acc = temp & 0xF; z = (acc == 0);
+    }
+    THREADED_DISPATCH();
+op_and:
+    acc = acc & RAM_READ(op.operand); z = (acc == 0);
+    THREADED_DISPATCH();
+op_or:
+    acc = acc | RAM_READ(op.operand); z = (acc == 0);
+    THREADED_DISPATCH();
+op_xor:
+    acc = acc ^ RAM_READ(op.operand); z = (acc == 0);
+    THREADED_DISPATCH();
+op_ldai:
+    acc = RAM_READ(RAM_READ(op.operand) & 0xF); z = (acc == 0);
+    THREADED_DISPATCH();
+op_stai:
+    RAM_WRITE(RAM_READ(op.operand) & 0xF, acc);
+    THREADED_DISPATCH();
+op_jmp:
+    pc = op.target;
+    THREADED_DISPATCH();
+op_jz:
+    pc = z ? op.target : (uint8_t)(pc + 1);
+    THREADED_DISPATCH();
+op_jc:
+    pc = c ? op.target : (uint8_t)(pc + 1);
+    THREADED_DISPATCH();
+op_call:
+    if (sp < stackSize) { stack[sp] = pc + 1; sp++; }
+    pc = op.target;
+    THREADED_DISPATCH();
+op_hlt:
+    halted = true;
+    goto done;
+op_rst:
+    Reset();
+    pc = PC; acc = ACC; sp = SP; z = Z; c = C;
+    RAM_SYNC_IN();
+    THREADED_DISPATCH();
+op_out:
+    EmitOutput(acc);
+    if (breakOnOutput) { outputStop = true; goto done; }
+    THREADED_DISPATCH();
+op_not:
+    acc = (~acc) & 0xF; z = (acc == 0);
+    THREADED_DISPATCH();
+op_push:
+    if (sp < stackSize) { stack[sp] = acc; sp++; }
+    THREADED_DISPATCH();
+op_pop:
+    if (sp > 0) { sp--; acc = stack[sp]; }
+    THREADED_DISPATCH();
+op_ret:
+    if (sp > 0) { sp--; pc = stack[sp]; }
+    THREADED_DISPATCH();
+op_lda_dev:
+    acc = bus.Read(op.operand); RAM_WRITE(op.operand, acc); z = (acc == 0);
+    THREADED_DISPATCH();
+op_sta_dev:
+    bus.Write(op.operand, acc);
+    RAM_WRITE(op.operand, acc & 0xF);
+    if (breakOnOutput) { outputStop = true; goto done; }
+    THREADED_DISPATCH();
+op_trap:
+    // Un-fetch: the trapped instruction has not run, and IR still names the last one that did.
+    pc--; executed--; ir = lastIr;
+    trapStop = true;
+    goto done;
+
+done:
+    PC = pc; ACC = acc; SP = sp; IR = ir; Z = z; C = c;
+    RAM_SYNC_OUT();
+    recorder = rec;
+    return executed;
+
+#undef THREADED_DISPATCH
+#undef RAM_READ
+#undef RAM_WRITE
+#undef RAM_SYNC_OUT
+#undef RAM_SYNC_IN
+#endif
+}
+
+#endif
@@ -0,0 +1,596 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Compact binary execution trace: one record per executed instruction, written by a buffered
+// recorder on the threaded engine (TraceWriter::Run) or as a RunHooked() observer, and read
+// back through a memory-mapped file.
+//
+// Record (1 byte for most instructions):
+//   [head]            bits 3-7 Decode::Handler, bit 0 JUMPED, bit 1 WRITE, bit 2 WIDE
+//   [pc delta]        if JUMPED: zigzag varint of (int8)(pc - expected pc), 1-2 bytes.
+//                     The expected pc is the previous record's pc plus its length, so only
+//                     taken jumps, CALL, RET and RST cost a delta.
+//   [payload]         depends on the handler (the reader knows it from the head byte):
+//     STA, STA 15     WRITE: cell << 4 | value (also STA to a device port)
+//     LDA 14          WRITE: 14 << 4 | value, once ResolveInput() has delivered the value
+//     LDA device      WRITE: cell << 4 | value read from the device
+//     STAI            WRITE: cell << 4 | (value & 0xF), then the full value byte if WIDE
+//     CALL, PUSH      WRITE: stack slot, value (absent when the stack was full)
+//     OUT             the output byte
+// Loads, ALU operations and flags are not stored: they follow from the ROM and the cells.
+//
+// File layout (host byte order; the reader rejects files from the other RAM layout):
+//   header   "C4TR", version, flags, sizeof(CPUState), 0, index interval (u32), ROM[256]
+//   records
+//   index    { u64 instruction, u64 file offset, CPUState before it } every INDEX_INTERVAL
+//            instructions, so any instruction is at most INDEX_INTERVAL records away
+//   trailer  u64 instructions, u64 index offset, u64 index entries, "C4TRIDX\0"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CPU4BIT_TRACE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CPU4BIT_TRACE_MMAP 0
+#endif
+
+namespace TraceFormat {
+    static const char MAGIC[4] = { 'C', '4', 'T', 'R' };
+    static const char INDEX_MAGIC[8] = { 'C', '4', 'T', 'R', 'I', 'D', 'X', '\0' };
+    static const uint8_t VERSION = 1;
+    static const uint32_t INDEX_INTERVAL = 4096;
+
+    static const uint8_t JUMPED = 0x01;
+    static const uint8_t WRITE = 0x02;
+    static const uint8_t WIDE = 0x04;
+
+#ifdef CPU4BIT_PACKED_RAM
+    static const uint8_t FLAGS = 0x01;
+#else
+    static const uint8_t FLAGS = 0x00;
+#endif
+
+    static const size_t HEADER_SIZE = 12 + 256;
+    static const size_t TRAILER_SIZE = 32;
+
+    struct IndexEntry {
+        uint64_t instruction;
+        uint64_t offset;
+        CPUState state;
+    };
+
+    // The reader decodes the ROM without the writer's devices, so a traced device access
+    // matches the plain LDA/STA (or built-in port) handler at the same address.
+    inline bool SameInstruction(uint8_t decoded, uint8_t traced){
+        if (traced == Decode::OP_LDA_DEV) return decoded == Decode::OP_LDA || decoded == Decode::OP_INPUT;
+        if (traced == Decode::OP_STA_DEV) return decoded == Decode::OP_STA || decoded == Decode::OP_STA_GPIO;
+        return decoded == traced;
+    }
+}
+
+class TraceWriter : public NoHooks {
+public:
+    static const size_t MAX_RECORD = 8;
+    // The buffer is only checked at index entries, so it holds a whole interval of records.
+    static const size_t BUFFER_SIZE = 1 << 16;
+    static_assert(BUFFER_SIZE >= 2 * TraceFormat::INDEX_INTERVAL * MAX_RECORD, "trace buffer too small");
+
+    // The encoding state between two index entries: where the next record goes, the pc it is
+    // expected at and an input record still waiting for its value. It is small so that
+    // RunRecorded() can keep its copy in registers for a whole engine run.
+    class Recorder {
+    public:
+        // RunRecorded() recorder, called through TraceWriter::Run(). Index entries fall on engine
+        // run boundaries, so the only slow path inside a run is completing an input record; the
+        // instruction after LDA 14 only runs once the value was delivered.
+        template <class ReadRAM>
+        void Record(const Decode::DecodedOp& op, uint8_t pc, uint8_t acc, uint8_t sp, ReadRAM read){
+            if (pendingHead) AppendInput(read(pendingCell));
+            Encode(op, pc, acc, sp, read);
+        }
+
+    private:
+        friend class TraceWriter;
+        static const uint32_t PAYLOAD_HANDLERS =
+            1u << Decode::OP_STA | 1u << Decode::OP_STA_GPIO | 1u << Decode::OP_STA_DEV | 1u << Decode::OP_STAI |
+            1u << Decode::OP_CALL | 1u << Decode::OP_PUSH | 1u << Decode::OP_OUT |
+            1u << Decode::OP_INPUT | 1u << Decode::OP_LDA_DEV;
+        static const size_t STACK_SIZE = std::tuple_size<decltype(CPUState::STACK)>::value;
+
+        uint8_t* out = nullptr;         // next free byte in the buffer
+        uint8_t* pendingHead = nullptr; // head of an LDA 14/device record awaiting its value
+        uint8_t pendingCell = 14;
+        uint8_t expectedPC = 0;
+
+        // Only called before the next record starts, so the pending record is still buffered.
+        void AppendInput(uint8_t value){
+            *pendingHead |= TraceFormat::WRITE;
+            *out++ = (uint8_t)(pendingCell << 4 | (value & 0xF));
+            pendingHead = nullptr;
+        }
+
+        template <class ReadRAM>
+        void Encode(const Decode::DecodedOp& op, const uint8_t pc, const uint8_t acc, const uint8_t sp, ReadRAM read){
+            uint8_t* start = out;
+            uint8_t* p = start + 1;
+            uint8_t head = (uint8_t)(op.handler << 3);
+            if (pc != expectedPC) {
+                int delta = (int8_t)(uint8_t)(pc - expectedPC);
+                uint8_t zigzag = (uint8_t)(delta >= 0 ? 2 * delta : -2 * delta - 1);
+                head |= TraceFormat::JUMPED;
+                if (zigzag < 0x80) {
+                    *p++ = zigzag;
+                } else {
+                    *p++ = (uint8_t)(zigzag | 0x80);
+                    *p++ = (uint8_t)(zigzag >> 7);
+                }
+            }
+
+            // Most instructions carry no payload: one bit test instead of a jump table.
+            if ((PAYLOAD_HANDLERS >> op.handler) & 1) {
+                switch (op.handler)
+                {
+                case Decode::OP_STA:
+                case Decode::OP_STA_GPIO:
+                case Decode::OP_STA_DEV:
+                    head |= TraceFormat::WRITE;
+                    *p++ = (uint8_t)(op.operand << 4 | (acc & 0xF));
+                    break;
+                case Decode::OP_STAI:
+                    head |= TraceFormat::WRITE;
+                    *p++ = (uint8_t)((read(op.operand) & 0xF) << 4 | (acc & 0xF));
+                    if (acc > 0xF) {
+                        head |= TraceFormat::WIDE;
+                        *p++ = acc;
+                    }
+                    break;
+                case Decode::OP_CALL:
+                case Decode::OP_PUSH:
+                    if (sp < STACK_SIZE) {
+                        head |= TraceFormat::WRITE;
+                        *p++ = sp;
+                        *p++ = (op.handler == Decode::OP_CALL) ? (uint8_t)(pc + 2) : acc;
+                    }
+                    break;
+                case Decode::OP_OUT:
+                    *p++ = acc;
+                    break;
+                case Decode::OP_INPUT:
+                case Decode::OP_LDA_DEV:
+                    pendingHead = start; // the value is only known once ResolveInput()/the device has run
+                    pendingCell = op.operand;
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            *start = head;
+            out = p;
+            expectedPC = (uint8_t)(pc + op.length);
+        }
+    };
+
+    TraceWriter() : buffer(BUFFER_SIZE) { recorder.out = buffer.data(); }
+    ~TraceWriter(){ if (file) std::fclose(file); }
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // Creates `path` and starts tracing from the current state of `cpu`.
+    bool Open(const std::string& path, const CPU4bit& cpu){
+        if (file) std::fclose(file);
+        file = std::fopen(path.c_str(), "wb");
+        failed = (file == nullptr);
+        if (failed) return false;
+
+        recorder = Recorder();
+        recorder.out = buffer.data();
+        uint8_t header[TraceFormat::HEADER_SIZE] = {};
+        std::memcpy(header, TraceFormat::MAGIC, 4);
+        header[4] = TraceFormat::VERSION;
+        header[5] = TraceFormat::FLAGS;
+        header[6] = (uint8_t)sizeof(CPUState);
+        uint32_t interval = TraceFormat::INDEX_INTERVAL;
+        std::memcpy(header + 8, &interval, 4);
+        std::memcpy(header + 12, cpu.ROM.data(), 256);
+        Write(header, sizeof(header));
+
+        index.clear();
+        written = TraceFormat::HEADER_SIZE;
+        count = 0;
+        AddIndexEntry(cpu);
+        return !failed;
+    }
+
+    // Flushes the records, appends the index and closes the file. `cpu` completes a trailing
+    // LDA 14 whose input was resolved after the last traced instruction.
+    bool Close(const CPU4bit& cpu){
+        if (!file) return false;
+        if (recorder.pendingHead) CompleteInput(cpu);
+        Flush();
+
+        uint64_t indexOffset = written;
+        for (const TraceFormat::IndexEntry& e : index)
+        {
+            Write(&e.instruction, 8);
+            Write(&e.offset, 8);
+            Write(&e.state, sizeof(CPUState));
+        }
+        uint64_t entries = index.size();
+        Write(&count, 8);
+        Write(&indexOffset, 8);
+        Write(&entries, 8);
+        Write(TraceFormat::INDEX_MAGIC, 8);
+
+        bool ok = (std::fclose(file) == 0) && !failed;
+        file = nullptr;
+        return ok;
+    }
+
+    // Call after changing the state outside an instruction (Restore, Reset) so the next
+    // instruction gets an index entry and StateAt() does not replay across the change.
+    void Resync(){ nextIndex = slowPathAt = count; }
+
+    uint64_t Instructions() const { return count; }
+    uint64_t RecordBytes() const { return written + Used() - TraceFormat::HEADER_SIZE; }
+    bool Failed() const { return failed; }
+
+    // Runs `cpu` on the threaded engine for up to `budget` instructions and records them: the
+    // same records as a RunHooked() run with this writer, at engine speed. Each engine run ends
+    // at the next index entry, where the writer needs the whole CPU state.
+    RunResult Run(CPU4bit& cpu, uint64_t budget = UINT64_MAX){
+        RunResult result;
+        while (true)
+        {
+            // Like BeforeExecute(), only before an instruction that is going to run
+            if (count == slowPathAt && result.executed < budget && !cpu.isHalted() && !cpu.isWaitingForInput) SlowPath(cpu);
+            RunResult part = cpu.RunRecorded(recorder, std::min(budget - result.executed, nextIndex - count));
+            count += part.executed;
+            slowPathAt = recorder.pendingHead ? count : nextIndex;
+            result.executed += part.executed;
+            result.reason = part.reason;
+            if (part.reason != StopReason::Budget || result.executed == budget) return result;
+        }
+    }
+
+    // RunHooked() observer.
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        if (count == slowPathAt) SlowPath(cpu);
+        recorder.Encode(op, cpu.PC, cpu.ACC, cpu.SP, [&cpu](uint8_t cell){ return cpu.ReadRAM(cell); });
+        count++;
+        if (recorder.pendingHead) slowPathAt = count;
+    }
+
+private:
+    std::FILE* file = nullptr;
+    std::vector<uint8_t> buffer;
+    Recorder recorder;
+    std::vector<TraceFormat::IndexEntry> index;
+    uint64_t written = 0;      // bytes already handed to the file
+    uint64_t count = 0;
+    uint64_t nextIndex = 0;
+    uint64_t slowPathAt = 0;   // next instruction that needs SlowPath(): min(nextIndex, pending input)
+    bool failed = false;
+
+    size_t Used() const { return (size_t)(recorder.out - buffer.data()); } // bytes in buffer
+
+    void Write(const void* data, size_t size){
+        if (std::fwrite(data, 1, size, file) != size) failed = true;
+    }
+
+    void Flush(){
+        Write(buffer.data(), Used());
+        written += Used();
+        recorder.out = buffer.data();
+    }
+
+    void CompleteInput(const CPU4bit& cpu){
+        if (!cpu.isWaitingForInput) recorder.AppendInput(cpu.ReadRAM(recorder.pendingCell));
+        recorder.pendingHead = nullptr;
+    }
+
+    void SlowPath(const CPU4bit& cpu){
+        if (recorder.pendingHead) CompleteInput(cpu);
+        if (count >= nextIndex) AddIndexEntry(cpu);
+        slowPathAt = nextIndex;
+    }
+
+    void AddIndexEntry(const CPU4bit& cpu){
+        if (Used() > BUFFER_SIZE - TraceFormat::INDEX_INTERVAL * MAX_RECORD) Flush();
+        index.push_back({ count, written + Used(), cpu.State() });
+        nextIndex = slowPathAt = count + TraceFormat::INDEX_INTERVAL;
+        recorder.expectedPC = cpu.PC; // first record after an entry never needs a delta
+    }
+};
+
+// One decoded trace record.
+struct TraceRecord {
+    uint64_t index = 0;        // instruction number, 0 = first traced instruction
+    uint8_t pc = 0;
+    uint8_t byte = 0;          // ROM[pc]
+    uint8_t handler = 0;       // Decode::Handler
+    bool jumped = false;       // pc differs from the previous pc + length
+    int ramCell = -1;          // cell written by STA/STAI/LDA 14, -1 if none
+    uint8_t ramValue = 0;
+    int stackSlot = -1;        // slot written by CALL/PUSH, -1 if none
+    uint8_t stackValue = 0;
+    bool output = false;       // OUT
+    uint8_t outputValue = 0;
+};
+
+class TraceReader {
+public:
+    TraceReader() = default;
+    ~TraceReader(){ Close(); }
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool Open(const std::string& path, std::string& error){
+        Close();
+        if (!Map(path)) { error = "cannot open " + path; return false; }
+        if (size < TraceFormat::HEADER_SIZE + TraceFormat::TRAILER_SIZE ||
+            std::memcmp(data, TraceFormat::MAGIC, 4) != 0) {
+            error = "not a trace file";
+            return false;
+        }
+        if (data[4] != TraceFormat::VERSION) { error = "unsupported trace version"; return false; }
+        if (data[5] != TraceFormat::FLAGS || data[6] != sizeof(CPUState)) {
+            error = "trace was written by a build with a different RAM layout";
+            return false;
+        }
+
+        const uint8_t* trailer = data + size - TraceFormat::TRAILER_SIZE;
+        uint64_t indexOffset = 0;
+        std::memcpy(&count, trailer, 8);
+        std::memcpy(&indexOffset, trailer + 8, 8);
+        std::memcpy(&entries, trailer + 16, 8);
+        if (std::memcmp(trailer + 24, TraceFormat::INDEX_MAGIC, 8) != 0) {
+            error = "trace has no index (writer not closed?)";
+            return false;
+        }
+        if (indexOffset < TraceFormat::HEADER_SIZE || indexOffset > size - TraceFormat::TRAILER_SIZE ||
+            entries == 0 || entries != (size - TraceFormat::TRAILER_SIZE - indexOffset) / ENTRY_SIZE) {
+            error = "corrupt trace index";
+            return false;
+        }
+        recordsEnd = indexOffset;
+        indexData = data + indexOffset;
+
+        std::memcpy(rom.data(), data + 12, 256);
+        for (int addr = 0; addr < 256; ++addr) decoded[addr] = Decode::DecodeAt(rom.data(), (uint8_t)addr);
+        return true;
+    }
+
+    void Close(){
+#if CPU4BIT_TRACE_MMAP
+        if (data) munmap((void*)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+        owned.clear();
+        count = entries = 0;
+    }
+
+    uint64_t Instructions() const { return count; }
+    uint64_t IndexEntries() const { return entries; }
+    uint64_t FileBytes() const { return size; }
+    uint64_t RecordBytes() const { return recordsEnd - TraceFormat::HEADER_SIZE; }
+    const std::array<uint8_t, 256>& ROM() const { return rom; }
+
+    // Sequential decoder; obtained from Seek().
+    class Cursor {
+    public:
+        // Decodes the next record; false at the end of the trace or on a malformed record.
+        bool Next(TraceRecord& r){
+            if (!reader || next >= reader->count || p >= end) return false;
+            uint8_t head = *p++;
+            r = TraceRecord();
+            r.index = next;
+            r.handler = (uint8_t)(head >> 3);
+            r.jumped = (head & TraceFormat::JUMPED) != 0;
+            r.pc = expectedPC;
+            if (r.jumped) {
+                uint32_t zigzag = 0;
+                if (!Byte(zigzag)) return false;
+                if (zigzag & 0x80) {
+                    uint32_t high = 0;
+                    if (!Byte(high)) return false;
+                    zigzag = (zigzag & 0x7F) | (high << 7);
+                }
+                int delta = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+                r.pc = (uint8_t)(expectedPC + delta);
+            }
+            const Decode::DecodedOp& op = reader->decoded[r.pc];
+            if (!TraceFormat::SameInstruction(op.handler, r.handler)) return false; // record does not match the ROM
+            r.byte = reader->rom[r.pc];
+
+            uint32_t a = 0, b = 0;
+            if (head & TraceFormat::WRITE) {
+                switch (r.handler)
+                {
+                case Decode::OP_STA:
+                case Decode::OP_STA_GPIO:
+                case Decode::OP_INPUT:
+                case Decode::OP_STAI:
+                case Decode::OP_LDA_DEV:
+                case Decode::OP_STA_DEV:
+                    if (!Byte(a)) return false;
+                    r.ramCell = (int)(a >> 4);
+                    r.ramValue = (uint8_t)(a & 0xF);
+                    if (head & TraceFormat::WIDE) {
+                        if (!Byte(b)) return false;
+                        r.ramValue = (uint8_t)b;
+                    }
+                    break;
+                case Decode::OP_CALL:
+                case Decode::OP_PUSH:
+                    if (!Byte(a) || !Byte(b)) return false;
+                    r.stackSlot = (int)a;
+                    r.stackValue = (uint8_t)b;
+                    break;
+                default:
+                    return false;
+                }
+            }
+            if (r.handler == Decode::OP_OUT) {
+                if (!Byte(a)) return false;
+                r.output = true;
+                r.outputValue = (uint8_t)a;
+            }
+
+            expectedPC = (uint8_t)(r.pc + op.length);
+            next++;
+            return true;
+        }
+
+    private:
+        friend class TraceReader;
+        const TraceReader* reader = nullptr;
+        const uint8_t* p = nullptr;
+        const uint8_t* end = nullptr;
+        uint64_t next = 0;
+        uint8_t expectedPC = 0;
+
+        bool Byte(uint32_t& out){
+            if (p >= end) return false;
+            out = *p++;
+            return true;
+        }
+    };
+
+    // Cursor whose first Next() returns record `instruction`; `state` (optional) receives the
+    // state of the index entry the cursor started from. Fails if instruction > Instructions().
+    bool Seek(uint64_t instruction, Cursor& cursor, CPUState* state = nullptr) const {
+        if (!data || instruction > count) return false;
+        TraceFormat::IndexEntry e = Entry(EntryFor(instruction));
+        if (e.offset < TraceFormat::HEADER_SIZE || e.offset > recordsEnd) return false;
+        cursor.reader = this;
+        cursor.p = data + e.offset;
+        cursor.end = data + recordsEnd;
+        cursor.next = e.instruction;
+        cursor.expectedPC = e.state.PC;
+        if (state) *state = e.state;
+
+        TraceRecord skipped;
+        while (cursor.next < instruction)
+        {
+            if (!cursor.Next(skipped)) return false;
+        }
+        return true;
+    }
+
+    // Record of instruction number `instruction` (random access through the index).
+    bool At(uint64_t instruction, TraceRecord& out) const {
+        Cursor cursor;
+        return Seek(instruction, cursor) && cursor.Next(out);
+    }
+
+    // Machine state just before instruction `instruction` ran (Instructions() = the final
+    // state): the nearest index state, replayed on the interpreter with the traced inputs.
+    // The console's last-event line may differ from the traced run; everything else is exact.
+    bool StateAt(uint64_t instruction, CPUState& out) const {
+        if (!data || instruction > count) return false;
+        uint64_t first = Entry(EntryFor(instruction)).instruction;
+        Cursor cursor;
+        CPU4bit cpu(ExecEngine::Switch);
+        std::vector<uint8_t> program(rom.begin(), rom.end());
+        cpu.LoadProgram(program, {});
+        if (!Seek(first, cursor, &cpu.State())) return false;
+
+        TraceRecord r;
+        while (cursor.next < instruction)
+        {
+            if (!cursor.Next(r) || r.pc != cpu.PC || cpu.isHalted() || cpu.isWaitingForInput) return false;
+            if (r.handler == Decode::OP_LDA_DEV || r.handler == Decode::OP_STA_DEV) {
+                // The devices are not here: apply the traced transfer (the replay CPU decodes
+                // the address as plain RAM or a built-in port)
+                cpu.IR = r.byte;
+                cpu.PC++;
+                cpu.WriteRAM((uint8_t)r.ramCell, r.ramValue);
+                if (r.handler == Decode::OP_LDA_DEV) { cpu.ACC = r.ramValue; cpu.Z = (cpu.ACC == 0); }
+                continue;
+            }
+            cpu.RunFor(1);
+            if (r.handler == Decode::OP_INPUT && r.ramCell == 14) cpu.ResolveInput((int)r.ramValue);
+        }
+        out = cpu.State();
+        return true;
+    }
+
+private:
+    static const size_t ENTRY_SIZE = 16 + sizeof(CPUState);
+
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+    std::vector<uint8_t> owned; // file contents when mmap is unavailable
+    const uint8_t* indexData = nullptr;
+    uint64_t recordsEnd = 0;
+    uint64_t count = 0;
+    uint64_t entries = 0;
+    std::array<uint8_t, 256> rom = {};
+    std::array<Decode::DecodedOp, 256> decoded = {};
+
+    bool Map(const std::string& path){
+#if CPU4BIT_TRACE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        bool ok = (fstat(fd, &st) == 0 && st.st_size > 0);
+        void* mem = ok ? mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (mem == MAP_FAILED) return false;
+        data = (const uint8_t*)mem;
+        size = (uint64_t)st.st_size;
+        return true;
+#else
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::fseek(f, 0, SEEK_END);
+        long length = std::ftell(f);
+        std::fseek(f, 0, SEEK_SET);
+        owned.resize(length > 0 ? (size_t)length : 0);
+        bool ok = length > 0 && std::fread(owned.data(), 1, owned.size(), f) == owned.size();
+        std::fclose(f);
+        if (!ok) return false;
+        data = owned.data();
+        size = owned.size();
+        return true;
+#endif
+    }
+
+    // Entries are written in instruction order, so the one for `instruction` is found by
+    // binary search (entries can be closer than INDEX_INTERVAL after Resync()).
+    uint64_t EntryFor(uint64_t instruction) const {
+        uint64_t lo = 0, hi = entries;
+        while (hi - lo > 1)
+        {
+            uint64_t mid = lo + (hi - lo) / 2;
+            uint64_t at = 0;
+            std::memcpy(&at, indexData + mid * ENTRY_SIZE, 8);
+            if (at <= instruction) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+    TraceFormat::IndexEntry Entry(uint64_t i) const {
+        TraceFormat::IndexEntry e;
+        const uint8_t* p = indexData + i * ENTRY_SIZE;
+        std::memcpy(&e.instruction, p, 8);
+        std::memcpy(&e.offset, p + 8, 8);
+        std::memcpy(&e.state, p + 16, sizeof(CPUState));
+        return e;
+    }
+};
+
+#endif
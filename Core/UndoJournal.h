@@ -0,0 +1,205 @@
+#ifndef UNDO_JOURNAL_H
+#define UNDO_JOURNAL_H
+
+// Per-instruction undo log for reverse execution (STEP BACK, reverse-run to a RAM write).
+//
+// Used as a RunHooked() observer: before every instruction it saves the register/flag word
+// and the one cell the instruction is about to overwrite (RAM, STACK, LED latch or console
+// ring slot). Instructions that change more than that (RST, LDA 14, which may take its
+// value from an input provider right away) and out-of-band changes (ResolveInput, Reset, a
+// run that was not journaled) save the whole 64-byte CPUState in a second, smaller ring.
+// Both rings are allocated once; recording never allocates.
+
+#include <cstdint>
+#include <vector>
+#include "CPU.h"
+
+class UndoJournal : public NoHooks {
+public:
+    static const uint64_t CAPACITY = 1 << 16;    // instructions that can be undone
+    static const uint64_t FULL_CAPACITY = 256;   // whole-state entries kept at the same time
+
+    enum Kind : uint8_t {
+        UNDO_NONE,     // registers/flags only
+        UNDO_RAM,      // RAM[index] = oldValue
+        UNDO_RAM_LED,  // STA 15: RAM[15] and the LED latch
+        UNDO_STACK,    // STACK[index] = oldValue
+        UNDO_OUT,      // console ring slot `index` plus its count/event; retracts the output log's newest value
+        UNDO_FULL      // whole CPUState in fullStates[fullSlot]; retracts the output log to where it was
+    };
+
+    struct Entry {
+        uint8_t regs[8];   // ACC, PC, IR, SP, Z, C, halted, isWaitingForInput (the first CPUState word)
+        uint8_t kind;
+        uint8_t index;
+        uint8_t oldValue;
+        uint8_t oldLeds;
+        uint8_t consoleCount;
+        uint8_t consoleEvent;
+        uint8_t consoleValue;
+        uint8_t fullSlot;
+    };
+    static_assert(sizeof(Entry) == 16, "journal entries are meant to stay 16 bytes");
+
+    UndoJournal() : entries(CAPACITY), fullStates(FULL_CAPACITY), fullOwner(FULL_CAPACITY, 0), fullOutputs(FULL_CAPACITY, 0) {}
+
+    void Clear(){ head = 0; oldestValid = 0; fullCount = 0; }
+
+    // Number of steps that can currently be undone.
+    uint64_t Depth() const {
+        uint64_t oldest = (head > CAPACITY) ? head - CAPACITY : 0;
+        if (oldestValid > oldest) oldest = oldestValid;
+        return head - oldest;
+    }
+
+    // Runs like CPU4bit::RunFor() while journaling every instruction.
+    RunResult Run(CPU4bit& cpu, uint64_t budget, bool stopOnOutput = false){
+        return cpu.RunHooked(*this, budget, stopOnOutput);
+    }
+
+    // Journal a state change that does not come from an instruction (input, reset).
+    void RecordFull(const CPU4bit& cpu){
+        Entry& e = Push(cpu);
+        SaveFull(e, cpu);
+    }
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        Entry& e = Push(cpu);
+        switch (op.handler)
+        {
+        case Decode::OP_STA:
+        case Decode::OP_STA_DEV:
+        case Decode::OP_LDA_DEV: // the loaded value is mirrored into the cell
+            SaveRAM(e, cpu, op.operand);
+            break;
+        case Decode::OP_STAI:
+            SaveRAM(e, cpu, cpu.ReadRAM(op.operand) & 0xF);
+            break;
+        case Decode::OP_STA_GPIO:
+            SaveRAM(e, cpu, 15);
+            e.kind = UNDO_RAM_LED;
+            e.oldLeds = cpu.getGPIO().getLEDs();
+            break;
+        case Decode::OP_CALL:
+        case Decode::OP_PUSH:
+            if (cpu.SP < cpu.STACK.size()) {
+                e.kind = UNDO_STACK;
+                e.index = cpu.SP;
+                e.oldValue = cpu.STACK[cpu.SP];
+            }
+            break;
+        case Decode::OP_OUT:
+            e.kind = UNDO_OUT;
+            e.index = cpu.console.head;
+            e.oldValue = cpu.console.bytes[cpu.console.head];
+            e.consoleCount = cpu.console.count;
+            e.consoleEvent = cpu.console.lastEvent;
+            e.consoleValue = cpu.console.lastValue;
+            break;
+        case Decode::OP_RST:
+        case Decode::OP_INPUT:
+            SaveFull(e, cpu);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Undoes the most recent journaled step. Returns false when there is nothing left.
+    bool StepBack(CPU4bit& cpu){
+        if (Depth() == 0) return false;
+        head--;
+        const Entry& e = entries[head & (CAPACITY - 1)];
+        switch (e.kind)
+        {
+        case UNDO_RAM:
+            cpu.WriteRAM(e.index, e.oldValue);
+            break;
+        case UNDO_RAM_LED:
+            cpu.WriteRAM(e.index, e.oldValue);
+            cpu.getGPIO().WriteOutputPort(e.oldLeds);
+            break;
+        case UNDO_STACK:
+            cpu.STACK[e.index] = e.oldValue;
+            break;
+        case UNDO_OUT:
+            cpu.console.bytes[e.index] = e.oldValue;
+            cpu.console.head = e.index;
+            cpu.console.count = e.consoleCount;
+            cpu.console.lastEvent = e.consoleEvent;
+            cpu.console.lastValue = e.consoleValue;
+            if (cpu.GetOutputLog()) cpu.GetOutputLog()->Retract();
+            break;
+        case UNDO_FULL:
+            cpu.Restore(fullStates[e.fullSlot]);
+            if (cpu.GetOutputLog()) cpu.GetOutputLog()->RetractTo(fullOutputs[e.fullSlot]);
+            break;
+        default:
+            break;
+        }
+        cpu.ACC = e.regs[0]; cpu.PC = e.regs[1]; cpu.IR = e.regs[2]; cpu.SP = e.regs[3];
+        cpu.Z = e.regs[4] != 0; cpu.C = e.regs[5] != 0;
+        cpu.halted = e.regs[6] != 0; cpu.isWaitingForInput = e.regs[7] != 0;
+        return true;
+    }
+
+    // Steps back until the most recent write to RAM[cell] has been undone, leaving the CPU
+    // just before the instruction that wrote it. Returns the number of steps undone;
+    // `found` is false if no journaled step wrote the cell, and then nothing is undone.
+    uint64_t ReverseToWrite(CPU4bit& cpu, uint8_t cell, bool& found){
+        found = false;
+        cell &= 0xF;
+        // Find the entry first: only entries that hit the cell change it, so its value stays
+        // `current` until the write is reached.
+        const uint8_t current = cpu.ReadRAM(cell);
+        const uint64_t depth = Depth();
+        uint64_t steps = 0;
+        while (steps < depth && !found)
+        {
+            const Entry& e = entries[(head - 1 - steps) & (CAPACITY - 1)];
+            steps++;
+            if ((e.kind == UNDO_RAM || e.kind == UNDO_RAM_LED) && e.index == cell) found = true;
+            else if (e.kind == UNDO_FULL && fullStates[e.fullSlot].ReadRAM(cell) != current) found = true;
+        }
+        if (!found) return 0;
+        for (uint64_t i = 0; i < steps; ++i) StepBack(cpu);
+        return steps;
+    }
+
+private:
+    std::vector<Entry> entries;        // ring, indexed by absolute step & (CAPACITY - 1)
+    std::vector<CPUState> fullStates;  // ring of whole-state entries
+    std::vector<uint64_t> fullOwner;   // absolute entry index that owns each full slot
+    std::vector<uint64_t> fullOutputs; // output log Total() when each full slot was saved
+    uint64_t head = 0;                 // absolute index of the next entry
+    uint64_t oldestValid = 0;          // entries below this lost their full-state slot
+    uint64_t fullCount = 0;
+
+    Entry& Push(const CPU4bit& cpu){
+        Entry& e = entries[head & (CAPACITY - 1)];
+        e.regs[0] = cpu.ACC; e.regs[1] = cpu.PC; e.regs[2] = cpu.IR; e.regs[3] = cpu.SP;
+        e.regs[4] = cpu.Z; e.regs[5] = cpu.C; e.regs[6] = cpu.halted; e.regs[7] = cpu.isWaitingForInput;
+        e.kind = UNDO_NONE;
+        head++;
+        return e;
+    }
+
+    static void SaveRAM(Entry& e, const CPU4bit& cpu, uint8_t addr){
+        e.kind = UNDO_RAM;
+        e.index = addr;
+        e.oldValue = cpu.ReadRAM(addr);
+    }
+
+    void SaveFull(Entry& e, const CPU4bit& cpu){
+        uint64_t slot = fullCount % FULL_CAPACITY;
+        if (fullCount >= FULL_CAPACITY && fullOwner[slot] + 1 > oldestValid) oldestValid = fullOwner[slot] + 1;
+        fullStates[slot] = cpu.State();
+        fullOwner[slot] = head - 1;
+        fullOutputs[slot] = cpu.GetOutputLog() ? cpu.GetOutputLog()->Total() : 0;
+        fullCount++;
+        e.kind = UNDO_FULL;
+        e.fullSlot = (uint8_t)slot;
+    }
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+// VCD (IEEE 1364 value change dump) export for comparing runs against an HDL model of the
+// CPU in GTKWave or a simulator's waveform diff.
+//
+// One timestep per executed instruction. Signals: pc[7:0], ir[7:0], acc[3:0], sp[4:0], z, c,
+// ram.cell0..cell15[3:0], gpio.led0..led3 and gpio.sw0..sw3. Values are cut to the declared
+// width like the 4-bit hardware would (ACC after POP and STAI cells can hold more in the
+// simulator). Only changed signals are written, into a 1 MiB block that is flushed when full,
+// so memory stays constant however long the run is.
+//
+// Use as a RunHooked() observer (the state is sampled after every instruction), and call
+// Sample() after changing the state between instructions (ResolveInput, switch toggles).
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+class VCDWriter : public NoHooks {
+public:
+    static const size_t BLOCK_SIZE = 1 << 20;
+
+    VCDWriter() : block(BLOCK_SIZE + SAMPLE_MAX) {}
+    ~VCDWriter(){ if (file) std::fclose(file); }
+    VCDWriter(const VCDWriter&) = delete;
+    VCDWriter& operator=(const VCDWriter&) = delete;
+
+    // Creates `path`, writes the declarations and dumps the current state of `cpu` at time 0.
+    bool Open(const std::string& path, const CPU4bit& cpu){
+        if (file) std::fclose(file);
+        file = std::fopen(path.c_str(), "wb");
+        failed = (file == nullptr);
+        if (failed) return false;
+
+        std::string out = "$comment CPU4bit execution, one timestep per instruction $end\n"
+                          "$timescale 1 ns $end\n"
+                          "$scope module cpu4bit $end\n";
+        for (int i = 0; i < SIGNALS; ++i)
+        {
+            if (i == RAM0) out += "$scope module ram $end\n";
+            if (i == LED0) out += "$scope module gpio $end\n";
+            out += "$var wire " + std::to_string(Width(i)) + " " + Id(i) + " " + Name(i) + " $end\n";
+            if (i == RAM0 + 15) out += "$upscope $end\n";
+        }
+        out += "$upscope $end\n$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n";
+        Write(out.data(), out.size());
+
+        time = 0;
+        flushed = out.size();
+        used = 0;
+        std::array<uint8_t, SIGNALS> now;
+        Capture(cpu, now);
+        for (int i = 0; i < SIGNALS; ++i) Value(i, now[i]);
+        Append("$end\n", 5);
+        last = now;
+        lastRAM = cpu.RAMWord();
+        lastGPIO = GPIOBits(cpu);
+        timeWritten = true;
+        return !failed;
+    }
+
+    bool Close(){
+        if (!file) return false;
+        WriteTime(time + 1); // lets viewers show the width of the last step
+        Flush();
+        bool ok = (std::fclose(file) == 0) && !failed;
+        file = nullptr;
+        return ok;
+    }
+
+    uint64_t Cycles() const { return time; }
+    uint64_t Bytes() const { return flushed + used; }
+
+    bool AfterExecute(const CPU4bit& cpu){
+        time++;
+        timeWritten = false;
+        Sample(cpu);
+        return false;
+    }
+
+    // Writes whatever changed since the last sample at the current timestep.
+    void Sample(const CPU4bit& cpu){
+        Change(PC, cpu.PC);
+        Change(IR, cpu.IR);
+        Change(ACC, cpu.ACC);
+        Change(SP, cpu.SP);
+        Change(Z, cpu.Z);
+        Change(C, cpu.C);
+        uint64_t ram = cpu.RAMWord();
+        if (ram != lastRAM) {
+            for (int i = 0; i < 16; ++i) Change(RAM0 + i, Nibble::Get(ram, (unsigned)i));
+            lastRAM = ram;
+        }
+        uint8_t gpio = GPIOBits(cpu);
+        if (gpio != lastGPIO) {
+            for (int i = 0; i < 4; ++i) Change(LED0 + i, (gpio >> i) & 1);
+            for (int i = 0; i < 4; ++i) Change(SW0 + i, (gpio >> (4 + i)) & 1);
+            lastGPIO = gpio;
+        }
+        if (used >= BLOCK_SIZE) Flush();
+    }
+
+private:
+    enum Signal { PC, IR, ACC, SP, Z, C, RAM0, LED0 = RAM0 + 16, SW0 = LED0 + 4, SIGNALS = SW0 + 4 };
+
+    static const size_t SAMPLE_MAX = 1024; // one sample writes far less than this
+
+    std::FILE* file = nullptr;
+    std::vector<char> block;
+    size_t used = 0;
+    std::array<uint8_t, SIGNALS> last = {};
+    uint64_t lastRAM = 0;
+    uint8_t lastGPIO = 0;
+    uint64_t time = 0;
+    uint64_t flushed = 0;
+    bool timeWritten = false;
+    bool failed = false;
+
+    static int Width(int s){
+        switch (s)
+        {
+        case PC: case IR: return 8;
+        case SP: return 5;
+        case Z: case C: return 1;
+        default: return (s >= LED0) ? 1 : 4;
+        }
+    }
+
+    static std::string Name(int s){
+        static const char* regs[] = { "pc", "ir", "acc", "sp", "z", "c" };
+        if (s < RAM0) return regs[s];
+        if (s < LED0) return "cell" + std::to_string(s - RAM0);
+        if (s < SW0) return "led" + std::to_string(s - LED0);
+        return "sw" + std::to_string(s - SW0);
+    }
+
+    static std::string Id(int s){ return std::string(1, (char)('!' + s)); }
+
+    static uint8_t GPIOBits(const CPU4bit& cpu){
+        return (uint8_t)((cpu.gpio.getLEDs() & 0xF) | (cpu.gpio.getSwitches() & 0xF) << 4);
+    }
+
+    static void Capture(const CPU4bit& cpu, std::array<uint8_t, SIGNALS>& v){
+        v[PC] = cpu.PC; v[IR] = cpu.IR; v[ACC] = cpu.ACC; v[SP] = cpu.SP; v[Z] = cpu.Z; v[C] = cpu.C;
+        for (int i = 0; i < 16; ++i) v[RAM0 + i] = cpu.ReadRAM((uint8_t)i);
+        uint8_t gpio = GPIOBits(cpu);
+        for (int i = 0; i < 4; ++i) { v[LED0 + i] = (gpio >> i) & 1; v[SW0 + i] = (gpio >> (4 + i)) & 1; }
+        for (int i = 0; i < SIGNALS; ++i) v[i] &= (uint8_t)((1u << Width(i)) - 1);
+    }
+
+    void Change(int s, uint8_t value){
+        value &= (uint8_t)((1u << Width(s)) - 1);
+        if (value == last[s]) return;
+        last[s] = value;
+        if (!timeWritten) WriteTime(time);
+        Value(s, value);
+    }
+
+    void WriteTime(uint64_t t){
+        char* p = block.data() + used;
+        *p++ = '#';
+        p = std::to_chars(p, p + 20, t).ptr;
+        *p++ = '\n';
+        used = (size_t)(p - block.data());
+        timeWritten = true;
+    }
+
+    // Shortest binary text of every byte value (leading zeros are implied in VCD).
+    struct Binary { char digits[8]; uint8_t length; };
+
+    static const std::array<Binary, 256>& BinaryTable(){
+        static const std::array<Binary, 256> table = [](){
+            std::array<Binary, 256> t = {};
+            for (int v = 0; v < 256; ++v)
+            {
+                int bit = 7;
+                while (bit > 0 && !((v >> bit) & 1)) bit--;
+                for (; bit >= 0; --bit) t[v].digits[t[v].length++] = (char)('0' + ((v >> bit) & 1));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    void Value(int s, uint8_t value){
+        char* p = block.data() + used;
+        int width = Width(s);
+        if (width == 1) {
+            *p++ = (char)('0' + (value & 1));
+        } else {
+            const Binary& bin = BinaryTable()[value];
+            *p++ = 'b';
+            std::memcpy(p, bin.digits, 8); // fixed-size copy, the block has slack
+            p += bin.length;
+            *p++ = ' ';
+        }
+        *p++ = (char)('!' + s);
+        *p++ = '\n';
+        used = (size_t)(p - block.data());
+    }
+
+    void Append(const char* text, size_t size){
+        std::memcpy(block.data() + used, text, size);
+        used += size;
+    }
+
+    void Write(const void* data, size_t size){
+        if (std::fwrite(data, 1, size, file) != size) failed = true;
+    }
+
+    void Flush(){
+        Write(block.data(), used);
+        flushed += used;
+        used = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef FLEET_RUNNER_H
+#define FLEET_RUNNER_H
+
+// Runs many (program, input script, expected output) jobs across all cores.
+//
+// Jobs are dealt round-robin into one deque per worker. A worker pops from the bottom of its
+// own deque and, when that is empty, steals from the top of another worker's deque, so the
+// jobs queued behind a long or non-terminating submission are picked up by idle workers.
+// Every worker keeps one CPU4bit and one Assembler for its whole lifetime.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Core/CPU.h"
+#include "../Core/Assembler.h"
+#include "../Core/LoopDetector.h"
+#include "HeadlessIO.h"
+
+struct FleetJob {
+    std::string programPath;
+    std::vector<uint8_t> inputs;
+    uint64_t budget = 10000000;
+    bool detectLoops = false;   // stop proven infinite loops early (status=loop)
+
+    bool checkLEDs = false;
+    uint8_t expectedLEDs = 0;
+    bool checkConsole = false;
+    std::string expectedConsole;
+    bool checkOutputs = false;
+    std::vector<uint8_t> expectedOutputs; // every OUT value, in order
+};
+
+struct FleetResult {
+    std::string status = "pending"; // halted | budget | input | loop | compile_error | io_error
+    bool passed = false;
+    uint64_t instructions = 0;
+    double wallMs = 0.0;
+    uint8_t leds = 0;
+    std::string console;
+    std::vector<uint8_t> outputs; // every OUT value, in order
+    bool outputsComplete = true;  // false if the run produced more than the log holds
+    std::string message;
+};
+
+struct FleetStats {
+    unsigned threads = 0;
+    size_t jobs = 0;
+    size_t passed = 0;
+    uint64_t instructions = 0;
+    double wallSeconds = 0.0;
+    uint64_t steals = 0;
+};
+
+// Owner pushes/pops at the bottom, thieves take from the top.
+class WorkStealingDeque {
+private:
+    std::deque<size_t> items;
+    std::mutex lock;
+
+public:
+    void PushBottom(size_t item){
+        std::lock_guard<std::mutex> guard(lock);
+        items.push_back(item);
+    }
+
+    bool PopBottom(size_t& item){
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty()) return false;
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+
+    bool Steal(size_t& item){
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty()) return false;
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+};
+
+class FleetRunner {
+private:
+    unsigned threadCount;
+
+    struct Worker {
+        CPU4bit cpu{ExecEngine::Threaded};
+        Assembler asmb;
+        LoopDetector loops;
+        OutputLog outputs;
+        Worker(){ cpu.SetOutputLog(&outputs); }
+    };
+
+    static void RunJob(Worker& w, const FleetJob& job, FleetResult& out){
+        auto start = std::chrono::steady_clock::now();
+
+        std::string source;
+        if (!ReadTextFile(job.programPath, source)) {
+            out.status = "io_error";
+            out.message = "Cannot open " + job.programPath;
+        } else {
+            CompileResult res = w.asmb.Assemble(source);
+            if (!res.success) {
+                out.status = "compile_error";
+                out.message = res.errorMessage;
+            } else {
+                CPU4bit& cpu = w.cpu;
+                cpu.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+                FifoInput input(job.inputs);
+                cpu.SetInputProvider(&input);
+                if (job.detectLoops) w.loops.Reset(cpu);
+                // One run: LDA 14 takes the job's inputs in the loop; the budget doubles as the watchdog
+                RunResult run = job.detectLoops ? cpu.RunHooked(w.loops, job.budget) : cpu.RunFor(job.budget);
+                cpu.SetInputProvider(nullptr);
+                switch (run.reason)
+                {
+                case StopReason::Halted: out.status = "halted"; break;
+                case StopReason::Predicate: out.status = "loop"; break;
+                case StopReason::WaitingForInput: out.status = "input"; break; // inputs used up
+                default: out.status = "budget"; break;
+                }
+                out.instructions = run.executed;
+                out.leds = cpu.getGPIO().getLEDs();
+                out.console = cpu.ConsoleText();
+                out.outputs = w.outputs.Values();
+                out.outputsComplete = (w.outputs.Oldest() == 0);
+                out.passed = (out.status == "halted") &&
+                             (!job.checkLEDs || out.leds == job.expectedLEDs) &&
+                             (!job.checkConsole || out.console == job.expectedConsole) &&
+                             (!job.checkOutputs || (out.outputsComplete && out.outputs == job.expectedOutputs));
+            }
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        out.wallMs = elapsed.count();
+    }
+
+public:
+    explicit FleetRunner(unsigned threads = 0) : threadCount(threads) {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<FleetResult> Run(const std::vector<FleetJob>& jobs, FleetStats& stats){
+        std::vector<FleetResult> results(jobs.size());
+        unsigned workers = (unsigned)std::max<size_t>(1, std::min<size_t>(threadCount, jobs.size()));
+        std::vector<WorkStealingDeque> deques(workers);
+        for (size_t i = 0; i < jobs.size(); ++i) deques[i % workers].PushBottom(i);
+
+        std::atomic<uint64_t> steals(0);
+        auto start = std::chrono::steady_clock::now();
+
+        auto workerMain = [&](unsigned self){
+            Worker w;
+            size_t job;
+            while (true)
+            {
+                bool found = deques[self].PopBottom(job);
+                for (unsigned k = 1; !found && k < workers; ++k)
+                {
+                    found = deques[(self + k) % workers].Steal(job);
+                    if (found) steals++;
+                }
+                if (!found) return; // jobs never spawn jobs: every deque is empty for good
+                RunJob(w, jobs[job], results[job]);
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < workers; ++t) pool.emplace_back(workerMain, t);
+        workerMain(0);
+        for (std::thread& t : pool) t.join();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        stats = FleetStats();
+        stats.threads = workers;
+        stats.jobs = jobs.size();
+        stats.wallSeconds = elapsed.count();
+        stats.steals = steals;
+        for (const FleetResult& r : results)
+        {
+            stats.passed += r.passed ? 1 : 0;
+            stats.instructions += r.instructions;
+        }
+        return results;
+    }
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef HEADLESS_IO_H
+#define HEADLESS_IO_H
+
+// Raylib-free helpers shared by the command line tools.
+// Utils/Utils.h pulls in raylib and tinyfiledialogs, so the tools must not include it.
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include "../Core/CPUState.h"
+#include "../Core/InputProvider.h" // ParseNibbleList
+
+inline bool ReadTextFile(const std::string& fileName, std::string& out){
+    std::ifstream file(fileName);
+    if (!file.is_open()) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    out = buffer.str();
+    return true;
+}
+
+// Unsigned decimal/hex/octal count. strtoull would wrap "-1" to 2^64-1 and skip leading
+// whitespace, so both are rejected up front.
+inline bool ParseCount(const std::string& text, uint64_t& out){
+    if (text.empty() || text[0] == '-' || text[0] == '+' || std::isspace((unsigned char)text[0])) return false;
+    char* end = nullptr;
+    unsigned long long val = std::strtoull(text.c_str(), &end, 0);
+    if (*end != '\0') return false;
+    out = (uint64_t)val;
+    return true;
+}
+
+// Quotes and escapes a string for the key=value result lines.
+inline std::string QuoteField(const std::string& text){
+    std::string out = "\"";
+    for (char ch : text)
+    {
+        if (ch == '"' || ch == '\\') out += '\\';
+        if (ch == '\n') { out += "\\n"; continue; }
+        out += ch;
+    }
+    return out + "\"";
+}
+
+// {3,4,10} -> "3,4,10" (the inverse of ParseNibbleList for values below 16).
+inline std::string FormatValueList(const std::vector<uint8_t>& values){
+    std::string out;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (i) out += ',';
+        out += std::to_string((int)values[i]);
+    }
+    return out;
+}
+
+// State part of the RESULT/STATE lines: pc=.. acc=.. z=.. c=.. sp=.. leds=.. ram=<16 hex digits> console="..."
+inline std::string StateFields(const CPUState& s){
+    char ram[17];
+    for (int i = 0; i < 16; ++i) ram[i] = "0123456789ABCDEF"[s.ReadRAM((uint8_t)i) & 0xF];
+    ram[16] = '\0';
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "pc=%d acc=%d z=%d c=%d sp=%d leds=%d ram=%s console=",
+        s.PC, s.ACC, s.Z ? 1 : 0, s.C ? 1 : 0, s.SP, s.gpio.getLEDs(), ram);
+    return buf + QuoteField(s.console.Text());
+}
+
+#endif
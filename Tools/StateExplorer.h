@@ -0,0 +1,335 @@
+#ifndef STATE_EXPLORER_H
+#define STATE_EXPLORER_H
+
+// Exhaustive exploration of every input sequence a program can receive.
+//
+// Between two inputs a CPU4bit is deterministic, and every input is one of 16 nibbles, so the
+// reachable behaviour is a graph whose nodes are the states waiting at `LDA 14`. Each node is
+// expanded 16 times (ResolveInput(0..15)), running the program to the next input request,
+// HLT, a proven infinite loop (LoopDetector) or the per-segment budget.
+//
+// Nodes are deduplicated in an open-addressing table of packed 32-byte keys (registers, flags,
+// LED latch, RAM nibbles, live stack entries), split into independently locked shards. Shards
+// double as they fill, up to a capacity derived from the memory budget (table plus the worst
+// case BFS frontier); once the table is full the exploration stops and reports itself as
+// incomplete instead of growing further. Levels of the BFS are expanded by all worker threads
+// in parallel.
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Core/CPU.h"
+#include "../Core/LoopDetector.h"
+
+// The part of a CPUState that decides what the program can still do, plus the LED latch.
+// The console is left out: it never influences execution.
+struct ExploreKey {
+    uint64_t ram = 0;   // 16 nibbles
+    uint64_t regs = 0;  // ACC | PC << 8 | SP << 16 | Z << 24 | C << 25 | LEDs << 26 | HALTED_BIT | USED_BIT
+    uint64_t stack[2] = { 0, 0 }; // STACK[0..SP-1]; entries above SP are dead and kept zero
+
+    static const uint64_t HALTED_BIT = 1ULL << 62;
+    static const uint64_t USED_BIT = 1ULL << 63; // never set in an empty table slot
+
+    bool operator==(const ExploreKey& o) const {
+        return ram == o.ram && regs == o.regs && stack[0] == o.stack[0] && stack[1] == o.stack[1];
+    }
+
+    uint64_t Hash() const {
+        uint64_t h = ram * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ (h >> 29) ^ regs) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 31) ^ stack[0]) * 0x94D049BB133111EBULL;
+        h = (h ^ (h >> 29) ^ stack[1]) * 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 32);
+    }
+
+    // Returns false if a RAM cell holds more than 4 bits (STAI of a popped return address),
+    // which the packed key cannot represent.
+    static bool Pack(const CPUState& s, ExploreKey& key){
+        key = ExploreKey();
+        for (uint8_t i = 0; i < 16; ++i)
+        {
+            uint8_t v = s.ReadRAM(i);
+            if (v > 15) return false;
+            key.ram |= (uint64_t)v << (4 * i);
+        }
+        key.regs = (uint64_t)s.ACC | ((uint64_t)s.PC << 8) | ((uint64_t)s.SP << 16) |
+                   ((uint64_t)s.Z << 24) | ((uint64_t)s.C << 25) | ((uint64_t)s.gpio.getLEDs() << 26) |
+                   (s.halted ? HALTED_BIT : 0) | USED_BIT;
+        for (uint8_t i = 0; i < s.SP && i < 16; ++i) key.stack[i / 8] |= (uint64_t)s.STACK[i] << (8 * (i % 8));
+        return true;
+    }
+};
+
+// Set of ExploreKeys with a hard capacity, safe to insert into from many threads.
+class VisitedSet {
+public:
+    enum InsertResult { INSERTED, PRESENT, FULL };
+    static const size_t SHARDS = 64;
+    static const size_t INITIAL_SHARD_SLOTS = 256;
+
+    // At most `maxSlots` slots in total (rounded down to a power of two per shard).
+    explicit VisitedSet(size_t maxSlots) : shards(new Shard[SHARDS]) {
+        maxShardSlots = INITIAL_SHARD_SLOTS;
+        while (maxShardSlots * 2 * SHARDS <= maxSlots) maxShardSlots <<= 1;
+        for (size_t i = 0; i < SHARDS; ++i) shards[i].slots.resize(INITIAL_SHARD_SLOTS);
+    }
+
+    InsertResult Insert(const ExploreKey& key){
+        uint64_t h = key.Hash();
+        Shard& shard = shards[h & (SHARDS - 1)];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        size_t mask = shard.slots.size() - 1;
+        for (size_t i = (size_t)(h >> 6) & mask;; i = (i + 1) & mask)
+        {
+            ExploreKey& slot = shard.slots[i];
+            if (!(slot.regs & ExploreKey::USED_BIT)) {
+                if (shard.used * 4 >= shard.slots.size() * 3) { // keep probe chains short
+                    if (shard.slots.size() >= maxShardSlots) return FULL;
+                    Grow(shard);
+                    return InsertNew(shard, key, h);
+                }
+                slot = key;
+                shard.used++;
+                return INSERTED;
+            }
+            if (slot == key) return PRESENT;
+        }
+    }
+
+    size_t Size() const {
+        size_t n = 0;
+        for (size_t i = 0; i < SHARDS; ++i) n += shards[i].used;
+        return n;
+    }
+
+    // Call once no thread is inserting any more.
+    size_t MemoryBytes() const {
+        size_t n = 0;
+        for (size_t i = 0; i < SHARDS; ++i) n += shards[i].slots.size() * sizeof(ExploreKey);
+        return n;
+    }
+
+private:
+    struct Shard {
+        std::mutex lock;
+        std::vector<ExploreKey> slots;
+        size_t used = 0;
+    };
+    std::unique_ptr<Shard[]> shards;
+    size_t maxShardSlots;
+
+    // Key known to be absent; the shard has room.
+    static InsertResult InsertNew(Shard& shard, const ExploreKey& key, uint64_t h){
+        size_t mask = shard.slots.size() - 1;
+        size_t i = (size_t)(h >> 6) & mask;
+        while (shard.slots[i].regs & ExploreKey::USED_BIT) i = (i + 1) & mask;
+        shard.slots[i] = key;
+        shard.used++;
+        return INSERTED;
+    }
+
+    static void Grow(Shard& shard){
+        std::vector<ExploreKey> old(shard.slots.size() * 2);
+        old.swap(shard.slots);
+        shard.used = 0;
+        for (const ExploreKey& k : old)
+        {
+            if (k.regs & ExploreKey::USED_BIT) InsertNew(shard, k, k.Hash());
+        }
+    }
+};
+
+struct ExploreOptions {
+    static const unsigned MAX_THREADS = 256;
+
+    unsigned threads = 0;                  // 0: one per hardware thread; at most MAX_THREADS
+    size_t memoryBytes = 256u << 20;       // visited table + frontier
+    uint64_t segmentBudget = 1000000;      // instructions between two inputs before giving up
+};
+
+struct ExploreReport {
+    uint64_t inputStates = 0;   // distinct states waiting for input
+    uint64_t segments = 0;      // runs between two inputs
+    uint64_t instructions = 0;
+    uint64_t haltedPaths = 0;
+    uint64_t loopPaths = 0;     // proven infinite loops
+    uint64_t budgetPaths = 0;   // neither halted nor looped within segmentBudget
+    uint64_t wideValuePaths = 0; // reached a RAM value wider than 4 bits (not representable)
+    bool tableFull = false;
+    std::vector<CPUState> haltStates; // distinct, sorted by LEDs, ACC, RAM
+    uint16_t ledValues = 0;     // bit v: the LED port was written with v at some point
+    uint8_t maxStackDepth = 0;
+    std::bitset<256> executed;  // ROM bytes fetched as an opcode or operand
+    unsigned threads = 0;
+    size_t memoryBytes = 0;     // visited table plus the largest pair of BFS levels held at once
+
+    bool Complete() const { return !tableFull && budgetPaths == 0 && wideValuePaths == 0; }
+};
+
+class StateExplorer {
+public:
+    explicit StateExplorer(const ExploreOptions& opts) : options(opts) {
+        if (options.threads == 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+        if (options.threads > ExploreOptions::MAX_THREADS) options.threads = ExploreOptions::MAX_THREADS;
+    }
+
+    // Explores every input sequence from the loaded state of `program`.
+    ExploreReport Explore(const CPU4bit& program){
+        ExploreReport report;
+        // Per slot: the key itself, plus (at 3/4 load) a state in the current and the next
+        // frontier in the worst case.
+        size_t bytesPerSlot = sizeof(ExploreKey) + 2 * sizeof(CPUState);
+        VisitedSet visited(options.memoryBytes / bytesPerSlot);
+        report.threads = options.threads;
+
+        std::vector<Worker> workers(options.threads);
+        for (Worker& w : workers) w.cpu = program;
+
+        std::vector<CPUState> frontier;
+        size_t peakStates = 0;
+        Segment(workers[0], visited, program.State(), false, 0, frontier);
+        while (!frontier.empty())
+        {
+            std::atomic<size_t> next(0);
+            auto expand = [&](Worker& w){
+                size_t i;
+                while ((i = next++) < frontier.size())
+                {
+                    for (uint8_t v = 0; v < 16; ++v) Segment(w, visited, frontier[i], true, v, w.next);
+                }
+            };
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < workers.size(); ++t) pool.emplace_back(expand, std::ref(workers[t]));
+            expand(workers[0]);
+            for (std::thread& t : pool) t.join();
+
+            size_t held = frontier.size();
+            for (const Worker& w : workers) held += w.next.size();
+            peakStates = std::max(peakStates, held);
+            frontier.clear();
+            for (Worker& w : workers)
+            {
+                frontier.insert(frontier.end(), w.next.begin(), w.next.end());
+                w.next.clear();
+            }
+            if (AnyFull(workers)) break;
+        }
+
+        for (Worker& w : workers)
+        {
+            const ExploreReport& r = w.report;
+            report.inputStates += r.inputStates;
+            report.segments += r.segments;
+            report.instructions += r.instructions;
+            report.haltedPaths += r.haltedPaths;
+            report.loopPaths += r.loopPaths;
+            report.budgetPaths += r.budgetPaths;
+            report.wideValuePaths += r.wideValuePaths;
+            report.tableFull |= r.tableFull;
+            report.haltStates.insert(report.haltStates.end(), r.haltStates.begin(), r.haltStates.end());
+            report.ledValues |= r.ledValues;
+            report.maxStackDepth = std::max(report.maxStackDepth, r.maxStackDepth);
+            report.executed |= r.executed;
+        }
+        std::sort(report.haltStates.begin(), report.haltStates.end(), [](const CPUState& a, const CPUState& b){
+            if (a.gpio.getLEDs() != b.gpio.getLEDs()) return a.gpio.getLEDs() < b.gpio.getLEDs();
+            if (a.ACC != b.ACC) return a.ACC < b.ACC;
+            return a.RAMWord() < b.RAMWord();
+        });
+        report.memoryBytes = visited.MemoryBytes() + peakStates * sizeof(CPUState);
+        return report;
+    }
+
+private:
+    ExploreOptions options;
+
+    // Records what a segment touches: executed ROM bytes, LED writes, stack depth.
+    struct CoverageHooks : NoHooks {
+        ExploreReport& report;
+        bool wroteLEDs = false;
+
+        explicit CoverageHooks(ExploreReport& r) : report(r) {}
+
+        void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+            report.executed.set(cpu.PC);
+            if (op.length == 2) report.executed.set((uint8_t)(cpu.PC + 1));
+            wroteLEDs = (op.handler == Decode::OP_STA_GPIO);
+        }
+
+        bool AfterExecute(const CPU4bit& cpu){
+            if (wroteLEDs) report.ledValues |= (uint16_t)(1u << cpu.getGPIO().getLEDs());
+            if (cpu.SP > report.maxStackDepth) report.maxStackDepth = cpu.SP;
+            return false;
+        }
+    };
+
+    struct Worker {
+        CPU4bit cpu;
+        LoopDetector loops;
+        ExploreReport report;
+        std::vector<CPUState> next;
+    };
+
+    static bool AnyFull(const std::vector<Worker>& workers){
+        for (const Worker& w : workers) if (w.report.tableFull) return true;
+        return false;
+    }
+
+    // Runs from `from` (after answering it with `input` when `resolve` is set) to the next stop.
+    void Segment(Worker& w, VisitedSet& visited, const CPUState& from, bool resolve, uint8_t input, std::vector<CPUState>& next){
+        CPU4bit& cpu = w.cpu;
+        ExploreReport& r = w.report;
+        cpu.State() = from;
+        if (resolve) cpu.ResolveInput((int)input);
+        w.loops.Reset(cpu);
+
+        CoverageHooks coverage(r);
+        HookPair<CoverageHooks, LoopDetector> hooks(coverage, w.loops);
+        RunResult run = cpu.RunHooked(hooks, options.segmentBudget);
+        r.segments++;
+        r.instructions += run.executed;
+
+        switch (run.reason)
+        {
+        case StopReason::Predicate:
+            r.loopPaths++;
+            return;
+        case StopReason::Halted:
+        case StopReason::WaitingForInput:
+            break;
+        default:
+            r.budgetPaths++;
+            return;
+        }
+
+        bool halted = (run.reason == StopReason::Halted);
+        if (halted) r.haltedPaths++;
+        ExploreKey key;
+        if (!ExploreKey::Pack(cpu.State(), key)) { r.wideValuePaths++; return; }
+        switch (visited.Insert(key))
+        {
+        case VisitedSet::INSERTED:
+            if (halted) {
+                r.haltStates.push_back(cpu.State());
+            } else {
+                r.inputStates++;
+                next.push_back(cpu.State());
+            }
+            break;
+        case VisitedSet::FULL:
+            r.tableFull = true;
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,345 @@
+// Interpreter benchmark: instructions/second of each execution path on the sample programs.
+//
+// Usage: cpu_bench [program.asm ...]   (defaults to Programs/program1.asm .. program7.asm)
+//
+// Every program is run to HLT over and over (inputs are answered with 5,3,5,3,...) until
+// at least MIN_INSTRUCTIONS have executed, restoring the loaded state between runs.
+// `make bench` runs this binary twice: cpu_bench (byte RAM) and cpu_bench_packed
+// (-DCPU4BIT_PACKED_RAM), so the two RAM layouts can be compared line by line.
+//
+// "decoded step" is Step() on the decode cache, one call per instruction; "fetch+execute"
+// decodes every instruction again. "decoded gain" is decoded step over fetch+execute, taken as
+// the median of GAIN_ROUNDS alternating short measurements because the two are close enough for
+// load changes to swamp a single pair. "threaded gain" is threaded run over fetch+execute.
+// "accelerated run" is LoopAccelerator::Run() on the threaded engine.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../Core/CPU.h"
+#include "../Core/Assembler.h"
+#include "../Core/JIT.h"
+#include "../Core/BatchCPU.h"
+#include "../Core/UndoJournal.h"
+#include "../Core/LoopAccelerator.h"
+#include "../Core/Trace.h"
+#include "../Core/Breakpoints.h"
+#include "HeadlessIO.h"
+
+static const uint64_t MIN_INSTRUCTIONS = 20000000;
+static const uint64_t RUN_BUDGET = 100000; // per run, guards against programs that never halt
+static const size_t BATCH_INSTANCES = 4096;
+static const uint64_t RAM_OPS = 50000000;
+static const int BREAK_ROUNDS = 15;
+static const int GAIN_ROUNDS = 15;
+static const uint64_t GAIN_INSTRUCTIONS = 2000000; // per round and path
+
+#ifdef _WIN32
+static const char* NULL_DEVICE = "NUL";
+#else
+static const char* NULL_DEVICE = "/dev/null";
+#endif
+
+#ifdef CPU4BIT_PACKED_RAM
+static const char* RAM_LAYOUT = "packed (1 x uint64_t)";
+#else
+static const char* RAM_LAYOUT = "bytes (16 x uint8_t)";
+#endif
+
+static void RestoreLoadedState(CPU4bit& cpu, const CPU4bit& initial){
+    cpu.State() = initial.State(); // one 64-byte copy
+}
+
+// Returns instructions per second. RunFn(cpu, budget) executes up to `budget` instructions and
+// returns how many ran; it is a lambda so single-step engines inline into the loop.
+template <class RunFn>
+static double Measure(CPU4bit& cpu, const CPU4bit& initial, RunFn run, uint64_t minInstructions = MIN_INSTRUCTIONS){
+    uint64_t total = 0;
+    int nextInput = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (total < minInstructions)
+    {
+        RestoreLoadedState(cpu, initial);
+        uint64_t executed = 0;
+        while (!cpu.isHalted() && executed < RUN_BUDGET)
+        {
+            if (cpu.isWaitingForInput) {
+                cpu.ResolveInput((uint8_t)((nextInput++ & 1) ? 3 : 5));
+                continue;
+            }
+            executed += run(cpu, RUN_BUDGET - executed);
+        }
+        total += executed;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return total / elapsed.count();
+}
+
+template <class RunFn>
+static double Measure(const CPU4bit& initial, RunFn run, uint64_t minInstructions = MIN_INSTRUCTIONS){
+    CPU4bit cpu = initial;
+    return Measure(cpu, initial, run, minInstructions);
+}
+
+static double MeasureJIT(const CPU4bit& initial){
+    CPU4bit cpu = initial;
+    CPU4bitJIT jit(cpu);
+    return Measure(cpu, initial, [&](CPU4bit&, uint64_t budget){ return jit.Run(budget); });
+}
+
+// Same ROM, BATCH_INSTANCES different input sequences: separate CPU4bit objects vs CPU4bitBatch.
+// Prints lane-instructions/second for both and whether every lane ended in the same state.
+static void BenchBatch(const std::string& path, const CPU4bit& initial){
+    std::vector<std::vector<uint8_t>> inputs(BATCH_INSTANCES);
+    for (size_t l = 0; l < BATCH_INSTANCES; ++l) inputs[l] = { (uint8_t)(l & 0xF), (uint8_t)((l >> 4) & 0xF) };
+
+    std::vector<CPU4bit> cpus(BATCH_INSTANCES, initial);
+    uint64_t separateTotal = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t l = 0; l < BATCH_INSTANCES; ++l)
+    {
+        CPU4bit& cpu = cpus[l];
+        size_t next = 0;
+        uint64_t executed = 0;
+        while (!cpu.isHalted() && executed < RUN_BUDGET)
+        {
+            if (cpu.isWaitingForInput) {
+                if (next >= inputs[l].size()) break;
+                cpu.ResolveInput((int)inputs[l][next++]);
+                continue;
+            }
+            executed += cpu.Run(RUN_BUDGET - executed);
+        }
+        separateTotal += executed;
+    }
+    std::chrono::duration<double> separateTime = std::chrono::steady_clock::now() - start;
+
+    CPU4bitBatch batch(initial, BATCH_INSTANCES);
+    for (size_t l = 0; l < BATCH_INSTANCES; ++l) batch.SetInputs(l, inputs[l]);
+    start = std::chrono::steady_clock::now();
+    uint64_t batchTotal = batch.Run(RUN_BUDGET);
+    std::chrono::duration<double> batchTime = std::chrono::steady_clock::now() - start;
+
+    bool same = (batchTotal == separateTotal);
+    CPU4bit lane = initial;
+    for (size_t l = 0; l < BATCH_INSTANCES && same; ++l)
+    {
+        batch.ReadLane(l, lane);
+        same = CPU4bitJIT::SameState(lane, cpus[l]);
+    }
+
+    std::printf("%-26s%14.1f M/s%14.1f M/s%18s\n", path.c_str(),
+        separateTotal / separateTime.count() / 1e6, batchTotal / batchTime.count() / 1e6, same ? "identical" : "MISMATCH");
+}
+
+// TraceWriter::Run() (records go to the null device, so this is the encoding and buffering
+// cost), the threaded engine alone for reference, and the record size. Both run on the
+// threaded engine, so the first column bounds the second.
+static void BenchTrace(const std::string& path, const CPU4bit& initialThreaded){
+    TraceWriter trace;
+    if (!trace.Open(NULL_DEVICE, initialThreaded)) { std::printf("%-26s cannot open %s\n", path.c_str(), NULL_DEVICE); return; }
+    double plain = Measure(initialThreaded, [](CPU4bit& cpu, uint64_t budget){ return cpu.RunFor(budget).executed; });
+    double rate = Measure(initialThreaded, [&](CPU4bit& cpu, uint64_t budget){ return trace.Run(cpu, budget).executed; });
+    std::printf("%-26s%14.1f M/s%14.1f M/s%18.3f\n", path.c_str(), plain / 1e6, rate / 1e6, (double)trace.RecordBytes() / trace.Instructions());
+    trace.Close(initialThreaded);
+}
+
+// Programs the loop accelerator is built for (the sample programs mostly loop over input,
+// output and the LEDs, which it leaves to the engine): "counting loops" runs 15 x 15 iterations
+// of a 21-instruction body that moves five cells by fixed steps, "idle loop" polls a cell that
+// never changes until the run's budget is used up.
+static const char* const COUNTING_LOOPS =
+    "    LDI 1\n    STA 13\n    LDI 3\n    STA 14\n    LDI 15\n    STA 12\n"
+    "OUTER:\n    LDI 15\n    STA 0\n"
+    "INNER:\n    LDA 1\n    ADD [13]\n    STA 1\n    LDA 2\n    ADD [14]\n    STA 2\n"
+    "    LDA 3\n    SUB [13]\n    STA 3\n    LDA 4\n    SUB [14]\n    STA 4\n"
+    "    LDA 5\n    ADD [13]\n    ADD [14]\n    STA 5\n"
+    "    LDA 0\n    SUB [13]\n    STA 0\n    JZ NEXT\n    JMP INNER\n"
+    "NEXT:\n    LDA 12\n    SUB [13]\n    STA 12\n    JZ DONE\n    JMP OUTER\n"
+    "DONE:\n    HLT\n";
+static const char* const IDLE_LOOP =
+    "    LDI 1\n    STA 13\n"
+    "WAIT:\n    LDA 0\n    ADD [13]\n    STA 0\n    LDA 3\n    JZ WAIT\n"
+    "    HLT\n";
+
+// The threaded engine alone and LoopAccelerator::Run() on it, with the share of instructions
+// the accelerator skipped instead of running.
+static void BenchLoops(Assembler& asmb, const char* name, const char* source){
+    CompileResult res = asmb.Assemble(source);
+    if (!res.success) { std::printf("%-26s skipped (%s)\n", name, res.errorMessage.c_str()); return; }
+    CPU4bit initial(ExecEngine::Threaded);
+    initial.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+    LoopAccelerator accelerator;
+    uint64_t ran = 0;
+    double plain = Measure(initial, [](CPU4bit& cpu, uint64_t budget){ return cpu.RunFor(budget).executed; });
+    double rate = Measure(initial, [&](CPU4bit& cpu, uint64_t budget){
+        uint64_t n = accelerator.Run(cpu, budget).executed;
+        ran += n;
+        return n;
+    });
+    std::printf("%-26s%14.1f M/s%14.1f M/s%17.1f%%\n", name, plain / 1e6, rate / 1e6, 100.0 * accelerator.SkippedInstructions() / ran);
+}
+
+// What the sim thread pays for breakpoints: the threaded engine alone (RunFor), then through
+// Breakpoints::Run() with a conditional PC breakpoint at the last ROM address (never reached,
+// so runs still end at HLT), then with a write watch on RAM[13] added. Every write to the cell
+// is a hit that ends the run; "watch hits" counts them per program run. The three are measured
+// back to back BREAK_ROUNDS times: rates are the best round, overheads the median of the
+// per-round overheads, so load that comes and goes between rounds cancels out.
+static void BenchBreakpoints(const std::string& path, const CPU4bit& initialThreaded){
+    Breakpoints breakpoint, watch;
+    BreakCondition condition;
+    std::string error;
+    BreakCondition::Parse("ACC==15 && [0]>3", condition, error);
+    breakpoint.SetPC(255, condition);
+    watch = breakpoint;
+    watch.CycleWatch(13);
+
+    double plain = 0, withBreak = 0, withWatch = 0;
+    std::vector<double> breakOverhead, watchOverhead;
+    for (int round = 0; round < BREAK_ROUNDS; ++round)
+    {
+        double p = Measure(initialThreaded, [](CPU4bit& cpu, uint64_t budget){ return cpu.RunFor(budget).executed; });
+        double b = Measure(initialThreaded, [&](CPU4bit& cpu, uint64_t budget){ return breakpoint.Run(cpu, budget).executed; });
+        double w = Measure(initialThreaded, [&](CPU4bit& cpu, uint64_t budget){ return watch.Run(cpu, budget).executed; });
+        plain = std::max(plain, p);
+        withBreak = std::max(withBreak, b);
+        withWatch = std::max(withWatch, w);
+        breakOverhead.push_back((p - b) / p);
+        watchOverhead.push_back((p - w) / p);
+    }
+    std::sort(breakOverhead.begin(), breakOverhead.end());
+    std::sort(watchOverhead.begin(), watchOverhead.end());
+
+    uint64_t hits = 0, executed = 0;
+    CPU4bit cpu = initialThreaded;
+    int nextInput = 0;
+    while (!cpu.isHalted() && executed < RUN_BUDGET)
+    {
+        if (cpu.isWaitingForInput) {
+            cpu.ResolveInput((uint8_t)((nextInput++ & 1) ? 3 : 5));
+            continue;
+        }
+        RunResult run = watch.Run(cpu, RUN_BUDGET - executed);
+        executed += run.executed;
+        if (run.reason == StopReason::Predicate) hits++;
+    }
+    std::printf("%-26s%14.1f M/s%14.1f M/s%17.1f%%%14.1f M/s%17.1f%%%18llu\n", path.c_str(), plain / 1e6,
+        withBreak / 1e6, 100.0 * breakOverhead[BREAK_ROUNDS / 2], withWatch / 1e6, 100.0 * watchOverhead[BREAK_ROUNDS / 2],
+        (unsigned long long)hits);
+}
+
+// Data-memory primitives on their own: a read-modify-write of one cell through
+// ReadMemory/WriteMemory, and "has RAM changed since the last snapshot" as done by
+// loop detection and history recording.
+static void BenchRAMOps(){
+    CPU4bit cpu;
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < RAM_OPS; ++i)
+    {
+        uint8_t addr = (uint8_t)((i * 7) & 0xE); // even cells below 15: no GPIO side effect
+        cpu.WriteMemory(addr, (uint8_t)(cpu.ReadMemory(addr) + 1));
+    }
+    std::chrono::duration<double> rmw = std::chrono::steady_clock::now() - start;
+    sink += cpu.RAMWord();
+
+    RamBank snapshot = cpu.RAM;
+    uint64_t changes = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < RAM_OPS; ++i)
+    {
+        cpu.WriteRAM((uint8_t)(i & 0xF), (uint8_t)(i >> 4));
+        if (!(cpu.RAM == snapshot)) { changes++; snapshot = cpu.RAM; }
+    }
+    std::chrono::duration<double> cmp = std::chrono::steady_clock::now() - start;
+    sink += changes;
+
+    std::printf("%-26s%14.1f M/s%14.1f M/s   (checksum %llu)\n", "ram ops",
+        RAM_OPS / rmw.count() / 1e6, RAM_OPS / cmp.count() / 1e6, (unsigned long long)sink);
+}
+
+int main(int argc, char** argv){
+    std::vector<std::string> programs;
+    for (int i = 1; i < argc; ++i) programs.push_back(argv[i]);
+    if (programs.empty()) {
+        for (int i = 1; i <= 7; ++i) programs.push_back("Programs/program" + std::to_string(i) + ".asm");
+    }
+
+    const char* columns[] = { "fetch+execute", "decoded step", "switch run", "threaded run", "jit run", "journaled run", "accelerated run", "decoded gain", "threaded gain" };
+
+    std::printf("RAM layout: %s%s\n\n", RAM_LAYOUT, CPU4bitJIT::IsSupported() ? "" : ", jit disabled (interpreter fallback)");
+    std::printf("%-26s", "program");
+    for (const char* name : columns) std::printf("%18s", name);
+    std::printf("\n");
+
+    Assembler asmb;
+    std::vector<std::pair<std::string, CPU4bit>> loaded;
+    std::vector<CPU4bit> loadedThreaded;
+    for (const std::string& path : programs)
+    {
+        std::string source;
+        if (!ReadTextFile(path, source)) { std::printf("%-26s cannot open\n", path.c_str()); continue; }
+        CompileResult res = asmb.Assemble(source);
+        if (!res.success) { std::printf("%-26s skipped (%s)\n", path.c_str(), res.errorMessage.c_str()); continue; }
+
+        CPU4bit initial(ExecEngine::Switch), initialThreaded(ExecEngine::Threaded);
+        UndoJournal journal;
+        LoopAccelerator accelerator;
+        initial.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+        initialThreaded.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+
+        auto stepRun = [](CPU4bit& cpu, uint64_t budget, auto step) -> uint64_t {
+            uint64_t n = 0;
+            while (n < budget && !cpu.isHalted() && !cpu.isWaitingForInput) { step(cpu); n++; }
+            return n;
+        };
+        auto fetchExecute = [&](CPU4bit& cpu, uint64_t budget){ return stepRun(cpu, budget, [](CPU4bit& c){ c.Fetch(); c.Execute(); }); };
+        auto decodedStep = [&](CPU4bit& cpu, uint64_t budget){ return stepRun(cpu, budget, [](CPU4bit& c){ c.Step(); }); };
+        double results[] = {
+            Measure(initial, fetchExecute),
+            Measure(initial, decodedStep),
+            Measure(initial, [](CPU4bit& cpu, uint64_t budget){ return cpu.Run(budget); }),
+            Measure(initialThreaded, [](CPU4bit& cpu, uint64_t budget){ return cpu.Run(budget); }),
+            MeasureJIT(initial),
+            Measure(initial, [&](CPU4bit& cpu, uint64_t budget){ return journal.Run(cpu, budget).executed; }),
+            Measure(initialThreaded, [&](CPU4bit& cpu, uint64_t budget){ return accelerator.Run(cpu, budget).executed; }),
+        };
+
+        std::vector<double> gains;
+        for (int round = 0; round < GAIN_ROUNDS; ++round)
+        {
+            double slow = Measure(initial, fetchExecute, GAIN_INSTRUCTIONS);
+            gains.push_back(Measure(initial, decodedStep, GAIN_INSTRUCTIONS) / slow);
+        }
+        std::sort(gains.begin(), gains.end());
+
+        std::printf("%-26s", path.c_str());
+        for (double r : results) std::printf("%14.1f M/s", r / 1e6);
+        std::printf("%17.2fx%17.1fx\n", gains[GAIN_ROUNDS / 2], results[3] / results[0]);
+        loaded.push_back({ path, initial });
+        loadedThreaded.push_back(initialThreaded);
+    }
+
+    std::printf("\n%-26s%18s%18s%18s   (%zu instances, %zu-lane vectors)\n", "batch",
+        "separate CPUs", "CPU4bitBatch", "lane states", BATCH_INSTANCES, CPU4bitBatch::VECTOR_LANES);
+    for (const auto& entry : loaded) BenchBatch(entry.first, entry.second);
+
+    std::printf("\n%-26s%18s%18s%18s\n", "trace", "threaded run", "traced run", "bytes/instr");
+    for (size_t i = 0; i < loaded.size(); ++i) BenchTrace(loaded[i].first, loadedThreaded[i]);
+
+    std::printf("\n%-26s%18s%18s%18s\n", "loop acceleration", "threaded run", "accelerated run", "skipped");
+    BenchLoops(asmb, "counting loops", COUNTING_LOOPS);
+    BenchLoops(asmb, "idle loop", IDLE_LOOP);
+
+    std::printf("\n%-26s%18s%18s%18s%18s%18s%18s\n", "breakpoints", "threaded run", "+ breakpoint", "overhead", "+ watch [13]", "overhead", "watch hits");
+    for (size_t i = 0; i < loaded.size(); ++i) BenchBreakpoints(loaded[i].first, loadedThreaded[i]);
+
+    std::printf("\n%-26s%18s%18s\n", "data memory", "read+write", "write+compare");
+    BenchRAMOps();
+    return 0;
+}
@@ -0,0 +1,123 @@
+// State-space explorer: runs a program against every possible input sequence.
+//
+// Usage: cpu_explore <program.asm> [--threads N] [--memory-mb N] [--segment-budget N] [--max-halts N]
+//
+// --threads N takes 1..256 (default: one per hardware thread).
+// Prints one HALT line per distinct reachable halt state (up to --max-halts, default 32) and
+// one summary line:
+// EXPLORE status=<complete|memory|budget|wide_values> input_states=N segments=N instructions=N
+//         halted_paths=N loop_paths=N budget_paths=N halt_states=N leds=<values> max_stack=N
+//         unreachable=<addresses> threads=N memory_mb=N wall_s=N
+// `unreachable` lists code bytes no input sequence ever fetches, as ranges ("4-7,12").
+// Exit codes: 0 explored completely, 1 usage/compile error, 2 incomplete (memory limit hit,
+//             a segment exceeded its budget, or a RAM cell held more than 4 bits).
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../Core/Assembler.h"
+#include "StateExplorer.h"
+#include "HeadlessIO.h"
+
+static void PrintUsage(){
+    std::fprintf(stderr, "usage: cpu_explore <program.asm> [--threads N] [--memory-mb N] [--segment-budget N] [--max-halts N]\n");
+}
+
+// "0,3,4-7" from a set of indices.
+template <class IsSet>
+static std::string Ranges(int count, IsSet isSet){
+    std::string out;
+    for (int i = 0; i < count; ++i)
+    {
+        if (!isSet(i)) continue;
+        int j = i;
+        while (j + 1 < count && isSet(j + 1)) j++;
+        if (!out.empty()) out += ',';
+        out += std::to_string(i);
+        if (j > i) out += "-" + std::to_string(j);
+        i = j;
+    }
+    return out.empty() ? "none" : out;
+}
+
+int main(int argc, char** argv){
+    std::string programPath;
+    ExploreOptions options;
+    uint64_t threads = 0, memoryMB = options.memoryBytes >> 20, maxHalts = 32;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--threads" && hasValue) {
+            if (!ParseCount(argv[++i], threads) || threads == 0 || threads > ExploreOptions::MAX_THREADS) {
+                std::fprintf(stderr, "cpu_explore: --threads takes 1..%u\n", ExploreOptions::MAX_THREADS);
+                return 1;
+            }
+        } else if (arg == "--memory-mb" && hasValue) {
+            if (!ParseCount(argv[++i], memoryMB) || memoryMB == 0) { PrintUsage(); return 1; }
+        } else if (arg == "--segment-budget" && hasValue) {
+            if (!ParseCount(argv[++i], options.segmentBudget)) { PrintUsage(); return 1; }
+        } else if (arg == "--max-halts" && hasValue) {
+            if (!ParseCount(argv[++i], maxHalts)) { PrintUsage(); return 1; }
+        } else if (programPath.empty() && arg[0] != '-') {
+            programPath = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (programPath.empty()) { PrintUsage(); return 1; }
+    options.threads = (unsigned)threads;
+    options.memoryBytes = (size_t)memoryMB << 20;
+
+    std::string source;
+    if (!ReadTextFile(programPath, source)) {
+        std::printf("EXPLORE status=compile_error line=-1 message=%s\n", QuoteField("Cannot open " + programPath).c_str());
+        return 1;
+    }
+    Assembler asmb;
+    CompileResult res = asmb.Assemble(source);
+    if (!res.success) {
+        std::printf("EXPLORE status=compile_error line=%d message=%s\n", res.errorLineIndex, QuoteField(res.errorMessage).c_str());
+        return 1;
+    }
+
+    CPU4bit cpu;
+    cpu.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+
+    auto start = std::chrono::steady_clock::now();
+    StateExplorer explorer(options);
+    ExploreReport report = explorer.Explore(cpu);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (size_t i = 0; i < report.haltStates.size() && i < maxHalts; ++i)
+    {
+        const CPUState& s = report.haltStates[i];
+        char ram[17];
+        for (int c = 0; c < 16; ++c) ram[c] = "0123456789ABCDEF"[s.ReadRAM((uint8_t)c) & 0xF];
+        ram[16] = '\0';
+        std::printf("HALT pc=%d acc=%d z=%d c=%d sp=%d leds=%d ram=%s\n",
+            s.PC, s.ACC, s.Z ? 1 : 0, s.C ? 1 : 0, s.SP, s.gpio.getLEDs(), ram);
+    }
+
+    const char* status = "complete";
+    if (report.tableFull) status = "memory";
+    else if (report.wideValuePaths != 0) status = "wide_values";
+    else if (report.budgetPaths != 0) status = "budget";
+
+    int codeSize = (int)std::min<size_t>(res.exe.machineCode.size(), 256);
+    std::string leds = Ranges(16, [&](int v){ return (report.ledValues >> v) & 1; });
+    std::string unreachable = Ranges(codeSize, [&](int a){ return !report.executed.test((size_t)a); });
+
+    std::printf("EXPLORE status=%s input_states=%llu segments=%llu instructions=%llu halted_paths=%llu loop_paths=%llu "
+                "budget_paths=%llu halt_states=%zu leds=%s max_stack=%d unreachable=%s threads=%u memory_mb=%.1f wall_s=%.3f\n",
+        status, (unsigned long long)report.inputStates, (unsigned long long)report.segments,
+        (unsigned long long)report.instructions, (unsigned long long)report.haltedPaths,
+        (unsigned long long)report.loopPaths, (unsigned long long)report.budgetPaths, report.haltStates.size(),
+        leds.c_str(), report.maxStackDepth, unreachable.c_str(), report.threads,
+        report.memoryBytes / (1024.0 * 1024.0), elapsed.count());
+    return report.Complete() ? 0 : 2;
+}
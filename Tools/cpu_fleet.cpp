@@ -0,0 +1,198 @@
+// Fleet runner: grades many programs in parallel with a work-stealing scheduler.
+//
+// Usage: cpu_fleet <manifest.txt | directory> [--threads N] [--budget N] [--detect-loops]
+//
+// Manifest: one job per line, '#' starts a comment. Paths are relative to the manifest.
+//     Programs/program1.asm leds=12
+//     submissions/alice.asm in=5,3 leds=5 console=">>> OUTPUT: 10" budget=500000
+//     submissions/bob.asm in=5,3 out=5,3,8
+// out= lists every value the program must OUT, in order.
+// Directory: every *.asm file is a job; optional <name>.in holds the input nibbles and
+// <name>.expect holds manifest-style keys (leds=, console=, out=, budget=).
+//
+// --detect-loops ends jobs whose machine state repeats with status=loop instead of burning the budget.
+// Output: one JOB line per job (in manifest order) and a FLEET summary line.
+// Exit code: 0 when every job passed, 2 otherwise, 1 on usage errors.
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "FleetRunner.h"
+#include "HeadlessIO.h"
+
+namespace fs = std::filesystem;
+
+static void PrintUsage(){
+    std::fprintf(stderr, "usage: cpu_fleet <manifest.txt | directory> [--threads N] [--budget N] [--detect-loops]\n");
+}
+
+// Whitespace separated tokens; double quotes group, backslash escapes inside quotes.
+static std::vector<std::string> Tokenize(const std::string& line){
+    std::vector<std::string> tokens;
+    std::string cur;
+    bool inQuotes = false, has = false;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        char ch = line[i];
+        if (inQuotes) {
+            if (ch == '\\' && i + 1 < line.size()) { cur += line[++i]; continue; }
+            if (ch == '"') { inQuotes = false; continue; }
+            cur += ch;
+        } else if (ch == '"') {
+            inQuotes = true; has = true;
+        } else if (ch == '#') {
+            break;
+        } else if (ch == ' ' || ch == '\t' || ch == '\r') {
+            if (has) { tokens.push_back(cur); cur.clear(); has = false; }
+        } else {
+            cur += ch; has = true;
+        }
+    }
+    if (has) tokens.push_back(cur);
+    return tokens;
+}
+
+static bool ApplyKey(const std::string& token, FleetJob& job, std::string& error){
+    size_t eq = token.find('=');
+    if (eq == std::string::npos) { error = "expected key=value, got " + token; return false; }
+    std::string key = token.substr(0, eq), val = token.substr(eq + 1);
+    uint64_t n = 0;
+    if (key == "in") {
+        job.inputs.clear();
+        if (!ParseNibbleList(val, job.inputs)) { error = "bad input list " + val; return false; }
+    } else if (key == "leds") {
+        if (!ParseCount(val, n) || n > 15) { error = "bad leds value " + val; return false; }
+        job.checkLEDs = true; job.expectedLEDs = (uint8_t)n;
+    } else if (key == "console") {
+        job.checkConsole = true; job.expectedConsole = val;
+    } else if (key == "out") {
+        job.expectedOutputs.clear();
+        if (!ParseNibbleList(val, job.expectedOutputs)) { error = "bad output list " + val; return false; }
+        job.checkOutputs = true;
+    } else if (key == "budget") {
+        if (!ParseCount(val, job.budget)) { error = "bad budget " + val; return false; }
+    } else {
+        error = "unknown key " + key;
+        return false;
+    }
+    return true;
+}
+
+static bool LoadManifest(const fs::path& manifest, uint64_t budget, std::vector<FleetJob>& jobs, std::string& error){
+    std::string text;
+    if (!ReadTextFile(manifest.string(), text)) { error = "cannot read " + manifest.string(); return false; }
+    std::stringstream ss(text);
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(ss, line))
+    {
+        lineNo++;
+        std::vector<std::string> tokens = Tokenize(line);
+        if (tokens.empty()) continue;
+        FleetJob job;
+        job.budget = budget;
+        fs::path program(tokens[0]);
+        job.programPath = (program.is_absolute() ? program : manifest.parent_path() / program).string();
+        for (size_t i = 1; i < tokens.size(); ++i)
+        {
+            if (!ApplyKey(tokens[i], job, error)) { error = manifest.string() + ":" + std::to_string(lineNo) + ": " + error; return false; }
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+static bool LoadDirectory(const fs::path& dir, uint64_t budget, std::vector<FleetJob>& jobs, std::string& error){
+    std::vector<fs::path> programs;
+    for (const auto& entry : fs::directory_iterator(dir))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".asm") programs.push_back(entry.path());
+    }
+    std::sort(programs.begin(), programs.end());
+
+    for (const fs::path& program : programs)
+    {
+        FleetJob job;
+        job.budget = budget;
+        job.programPath = program.string();
+
+        fs::path inPath = program, expectPath = program;
+        inPath.replace_extension(".in");
+        expectPath.replace_extension(".expect");
+        std::string text;
+        if (ReadTextFile(inPath.string(), text) && !ParseNibbleList(text, job.inputs)) {
+            error = "bad input file " + inPath.string();
+            return false;
+        }
+        if (ReadTextFile(expectPath.string(), text)) {
+            std::stringstream ss(text);
+            std::string line;
+            while (std::getline(ss, line))
+            {
+                for (const std::string& token : Tokenize(line))
+                {
+                    if (!ApplyKey(token, job, error)) { error = expectPath.string() + ": " + error; return false; }
+                }
+            }
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+int main(int argc, char** argv){
+    std::string target;
+    uint64_t budget = 10000000;
+    uint64_t threads = 0;
+    bool detectLoops = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--threads" && hasValue) {
+            if (!ParseCount(argv[++i], threads)) { PrintUsage(); return 1; }
+        } else if (arg == "--budget" && hasValue) {
+            if (!ParseCount(argv[++i], budget)) { PrintUsage(); return 1; }
+        } else if (arg == "--detect-loops") {
+            detectLoops = true;
+        } else if (target.empty() && arg[0] != '-') {
+            target = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (target.empty()) { PrintUsage(); return 1; }
+
+    std::vector<FleetJob> jobs;
+    std::string error;
+    bool ok = fs::is_directory(target) ? LoadDirectory(target, budget, jobs, error)
+                                       : LoadManifest(target, budget, jobs, error);
+    if (!ok) { std::fprintf(stderr, "cpu_fleet: %s\n", error.c_str()); return 1; }
+    for (FleetJob& job : jobs) job.detectLoops = detectLoops;
+
+    FleetRunner runner((unsigned)threads);
+    FleetStats stats;
+    std::vector<FleetResult> results = runner.Run(jobs, stats);
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const FleetResult& r = results[i];
+        std::printf("JOB index=%zu program=%s status=%s result=%s instructions=%llu wall_ms=%.3f leds=%d console=%s",
+            i, QuoteField(jobs[i].programPath).c_str(), r.status.c_str(), r.passed ? "pass" : "fail",
+            (unsigned long long)r.instructions, r.wallMs, r.leds, QuoteField(r.console).c_str());
+        std::printf(" outputs=%s%s", r.outputsComplete ? "" : "...,", FormatValueList(r.outputs).c_str());
+        if (!r.message.empty()) std::printf(" message=%s", QuoteField(r.message).c_str());
+        std::printf("\n");
+    }
+
+    double seconds = stats.wallSeconds > 0 ? stats.wallSeconds : 1e-9;
+    std::printf("FLEET jobs=%zu passed=%zu failed=%zu threads=%u steals=%llu instructions=%llu wall_s=%.3f jobs_per_s=%.1f mips=%.1f\n",
+        stats.jobs, stats.passed, stats.jobs - stats.passed, stats.threads, (unsigned long long)stats.steals,
+        (unsigned long long)stats.instructions, stats.wallSeconds, stats.jobs / seconds, stats.instructions / seconds / 1e6);
+    return (stats.passed == stats.jobs) ? 0 : 2;
+}
@@ -0,0 +1,92 @@
+// GDB server: assembles a program and serves it to one debugger session over the GDB remote
+// serial protocol (see Core/GdbStub.h for the address map and registers).
+//
+// Usage: cpu_gdb <program.asm> [--port N | --unix PATH] [--input 3,4,5] [--input-file inputs.txt]
+//
+// Listens on 127.0.0.1:1234 by default, e.g. `target remote :1234` from a GDB built for any
+// target, or a test script speaking the protocol. --input/--input-file queue values for LDA 14
+// ("monitor input N" adds more during the session).
+// Prints one LISTEN line once the socket is ready and one SESSION line when the debugger leaves:
+// SESSION instructions=N pc=.. halted=0|1
+// Exit codes: 0 session ended, 1 usage/compile error or the socket could not be opened.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../Core/Assembler.h"
+#include "../Core/GdbStub.h"
+#include "HeadlessIO.h"
+
+static const int DEFAULT_PORT = 1234;
+
+static void PrintUsage(){
+    std::fprintf(stderr, "usage: cpu_gdb <program.asm> [--port N | --unix PATH] [--input 3,4,5] [--input-file inputs.txt]\n");
+}
+
+int main(int argc, char** argv){
+    std::string programPath, unixPath;
+    uint64_t port = DEFAULT_PORT;
+    std::vector<uint8_t> inputs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--port" && hasValue) {
+            if (!ParseCount(argv[++i], port) || port == 0 || port > 65535) { PrintUsage(); return 1; }
+        } else if (arg == "--unix" && hasValue) {
+            unixPath = argv[++i];
+        } else if (arg == "--input" && hasValue) {
+            if (!ParseNibbleList(argv[++i], inputs)) { PrintUsage(); return 1; }
+        } else if (arg == "--input-file" && hasValue) {
+            std::string text;
+            if (!ReadTextFile(argv[++i], text) || !ParseNibbleList(text, inputs)) {
+                std::fprintf(stderr, "cpu_gdb: cannot read input file %s\n", argv[i]);
+                return 1;
+            }
+        } else if (programPath.empty() && arg[0] != '-') {
+            programPath = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (programPath.empty()) { PrintUsage(); return 1; }
+
+    std::string source;
+    if (!ReadTextFile(programPath, source)) {
+        std::fprintf(stderr, "cpu_gdb: cannot open %s\n", programPath.c_str());
+        return 1;
+    }
+    Assembler asmb;
+    CompileResult res = asmb.Assemble(source);
+    if (!res.success) {
+        std::fprintf(stderr, "cpu_gdb: line %d: %s\n", res.errorLineIndex + 1, res.errorMessage.c_str());
+        return 1;
+    }
+
+    CPU4bit cpu;
+    cpu.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+    GdbStub stub(cpu);
+    stub.QueueInputs(inputs);
+
+    GdbConnection connection;
+    std::string error;
+    bool listening = unixPath.empty() ? connection.ListenTCP((int)port, error) : connection.ListenUnix(unixPath, error);
+    if (!listening) {
+        std::fprintf(stderr, "cpu_gdb: %s\n", error.c_str());
+        return 1;
+    }
+    if (unixPath.empty()) std::printf("LISTEN tcp=127.0.0.1:%llu\n", (unsigned long long)port);
+    else std::printf("LISTEN unix=%s\n", unixPath.c_str());
+    std::fflush(stdout);
+
+    if (!connection.Accept()) {
+        std::fprintf(stderr, "cpu_gdb: accept failed\n");
+        return 1;
+    }
+    stub.Serve(connection);
+    std::printf("SESSION instructions=%llu pc=%d halted=%d\n", (unsigned long long)stub.Executed(), cpu.PC, cpu.isHalted() ? 1 : 0);
+    return 0;
+}
@@ -0,0 +1,373 @@
+// Headless batch runner: assembles a program and runs it to HLT at full host speed.
+// Links only Core/ (no raylib), so it can be used on display-less grading machines.
+//
+// Usage: cpu_run <program.asm> [--budget N] [--input 3,4,5] [--input-file inputs.txt] [--engine switch|threaded|jit] [--lockstep]
+//                [--history] [--state-at STEP]... [--detect-loops] [--accelerate-loops] [--cross-check]
+//                [--profile-csv FILE] [--profile-json FILE] [--trace FILE] [--call-trace FILE] [--vcd FILE]
+//                [--device ADDR=random[:SEED]|timer[:MICROS]|console|capture|switches]... [--outputs]
+//
+// Prints exactly one machine-readable line:
+// RESULT status=<halted|budget|input|loop|compile_error> instructions=N pc=.. acc=.. z=.. c=.. sp=.. leds=.. ram=<16 hex digits> console="..."
+// --history records every step (interpreter only) and adds a HISTORY line with its memory use;
+// each --state-at STEP (implies --history) adds a STATE line rebuilt from that history.
+// --detect-loops (interpreter only) stops as soon as a machine state repeats and adds a LOOP line
+// with the cycle length and the PC range it covers.
+// --accelerate-loops (interpreter only) fast-forwards counting loops and adds an ACCEL line with
+// what was skipped; --cross-check (implies it) replays every fast-forward on the interpreter.
+// --profile-csv / --profile-json (interpreter only) write per-address execution counts, JZ/JC
+// taken/not-taken counts and per-cell RAM reads/writes.
+// --trace FILE (interpreter only) writes a binary execution trace (see Core/Trace.h, read it back
+// with cpu_trace) and adds a TRACE line with its size.
+// --call-trace FILE (interpreter only) streams CALL/RET slices as Chrome Trace Event JSON (see
+// Core/CallTrace.h) and adds a CALLS line.
+// --vcd FILE (interpreter only) writes a VCD waveform of the registers, flags, RAM cells and GPIO
+// pins, one timestep per instruction, and adds a VCD line.
+// --device ADDR=KIND (repeatable) maps a peripheral at RAM address ADDR (see Core/PeripheralBus.h)
+// and adds a DEVICE line; console shows the characters written, capture the values written.
+// --outputs adds an OUTPUTS line with every OUT value in order (up to the last 65536).
+// The interpreter-only options are a usage error together with --engine or --lockstep, and so are
+// --accelerate-loops together with --engine jit or --lockstep.
+// Exit codes: 0 halted, 1 usage/compile error, 2 budget exhausted, 3 waiting for input with no input left,
+//             4 JIT or loop accelerator diverged from the interpreter (--lockstep/--cross-check, status=diverged),
+//             5 provably non-terminating (--detect-loops, status=loop).
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Core/CPU.h"
+#include "../Core/Assembler.h"
+#include "../Core/JIT.h"
+#include "../Core/History.h"
+#include "../Core/LoopDetector.h"
+#include "../Core/LoopAccelerator.h"
+#include "../Core/Profiler.h"
+#include "../Core/Trace.h"
+#include "../Core/CallTrace.h"
+#include "../Core/Waveform.h"
+#include "HeadlessIO.h"
+
+static const uint64_t DEFAULT_BUDGET = 10000000;
+
+static void PrintUsage(){
+    std::fprintf(stderr, "usage: cpu_run <program.asm> [--budget N] [--input 3,4,5] [--input-file inputs.txt] [--engine switch|threaded|jit] [--lockstep] [--history] [--state-at STEP]... [--detect-loops] [--accelerate-loops] [--cross-check] [--profile-csv FILE] [--profile-json FILE] [--trace FILE] [--call-trace FILE] [--vcd FILE] [--device ADDR=KIND]... [--outputs]\n");
+}
+
+// One --device option: "13=random:7" -> { 13, "random", 7 }.
+struct DeviceOption {
+    uint64_t address = 0;
+    std::string kind;
+    uint64_t param = 0;
+    bool hasParam = false;
+};
+
+static bool ParseDeviceOption(const std::string& text, DeviceOption& out){
+    size_t eq = text.find('=');
+    if (eq == std::string::npos || !ParseCount(text.substr(0, eq), out.address) || out.address > 15) return false;
+    out.kind = text.substr(eq + 1);
+    size_t colon = out.kind.find(':');
+    if (colon != std::string::npos) {
+        if (!ParseCount(out.kind.substr(colon + 1), out.param)) return false;
+        out.kind.resize(colon);
+        out.hasParam = true;
+    }
+    return out.kind == "random" || out.kind == "timer" || out.kind == "console" ||
+           out.kind == "capture" || out.kind == "switches";
+}
+
+static std::unique_ptr<Peripheral> MakeDevice(const DeviceOption& opt, const CPU4bit& cpu){
+    if (opt.kind == "random") return std::unique_ptr<Peripheral>(new RandomDevice(opt.hasParam ? opt.param : 1));
+    if (opt.kind == "timer") return std::unique_ptr<Peripheral>(new TimerDevice(opt.hasParam ? opt.param : 1000));
+    if (opt.kind == "console") return std::unique_ptr<Peripheral>(new ConsoleDevice());
+    if (opt.kind == "capture") return std::unique_ptr<Peripheral>(new CaptureDevice());
+    return std::unique_ptr<Peripheral>(new SwitchPort(cpu.getGPIO()));
+}
+
+// The interpreter-path observers requested on the command line. Which ones run is decided per
+// instruction here, which is fine for a command line tool; the CPU itself stays hook-free.
+struct RunObservers : NoHooks {
+    StateHistory* history = nullptr;
+    LoopDetector* loops = nullptr;
+    ExecutionProfile* profile = nullptr;
+    TraceWriter* trace = nullptr;
+    CallTraceWriter* calls = nullptr;
+    VCDWriter* vcd = nullptr;
+
+    bool Any() const { return history || loops || profile || trace || calls || vcd; }
+    // A trace on its own is recorded from the threaded engine (TraceWriter::Run).
+    bool OnlyTrace() const { return trace && !history && !loops && !profile && !calls && !vcd; }
+
+    void BeforeExecute(const CPU4bit& cpu, const Decode::DecodedOp& op){
+        if (loops) loops->BeforeExecute(cpu, op);
+        if (profile) profile->BeforeExecute(cpu, op);
+        if (trace) trace->BeforeExecute(cpu, op);
+        if (calls) calls->BeforeExecute(cpu, op);
+    }
+
+    bool AfterExecute(const CPU4bit& cpu){
+        if (history) history->AfterExecute(cpu);
+        if (vcd) vcd->AfterExecute(cpu);
+        return loops && loops->AfterExecute(cpu);
+    }
+};
+
+static bool WriteTextFile(const std::string& path, const std::string& text){
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+int main(int argc, char** argv){
+    std::string programPath;
+    uint64_t budget = DEFAULT_BUDGET;
+    std::vector<uint8_t> inputs;
+    ExecEngine engine = ExecEngine::Threaded;
+    bool useJIT = false;
+    bool engineChosen = false;
+    bool lockstep = false;
+    bool recordHistory = false;
+    bool detectLoops = false;
+    bool accelerate = false;
+    bool crossCheck = false;
+    std::string profileCSV, profileJSON, tracePath, callTracePath, vcdPath;
+    std::vector<uint64_t> stateSteps;
+    std::vector<DeviceOption> deviceOptions;
+    bool printOutputs = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--budget" && hasValue) {
+            if (!ParseCount(argv[++i], budget)) { PrintUsage(); return 1; }
+        } else if (arg == "--input" && hasValue) {
+            if (!ParseNibbleList(argv[++i], inputs)) { PrintUsage(); return 1; }
+        } else if (arg == "--input-file" && hasValue) {
+            std::string text;
+            if (!ReadTextFile(argv[++i], text) || !ParseNibbleList(text, inputs)) {
+                std::fprintf(stderr, "cpu_run: cannot read input file %s\n", argv[i]);
+                return 1;
+            }
+        } else if (arg == "--engine" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "switch") engine = ExecEngine::Switch;
+            else if (name == "threaded") engine = ExecEngine::Threaded;
+            else if (name == "jit") useJIT = true;
+            else { PrintUsage(); return 1; }
+            engineChosen = true;
+        } else if (arg == "--lockstep") {
+            lockstep = true;
+            engineChosen = true;
+        } else if (arg == "--history") {
+            recordHistory = true;
+        } else if (arg == "--state-at" && hasValue) {
+            uint64_t step = 0;
+            if (!ParseCount(argv[++i], step)) { PrintUsage(); return 1; }
+            stateSteps.push_back(step);
+            recordHistory = true;
+        } else if (arg == "--detect-loops") {
+            detectLoops = true;
+        } else if (arg == "--accelerate-loops") {
+            accelerate = true;
+        } else if (arg == "--profile-csv" && hasValue) {
+            profileCSV = argv[++i];
+        } else if (arg == "--profile-json" && hasValue) {
+            profileJSON = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            tracePath = argv[++i];
+        } else if (arg == "--call-trace" && hasValue) {
+            callTracePath = argv[++i];
+        } else if (arg == "--vcd" && hasValue) {
+            vcdPath = argv[++i];
+        } else if (arg == "--device" && hasValue) {
+            DeviceOption opt;
+            if (!ParseDeviceOption(argv[++i], opt)) { PrintUsage(); return 1; }
+            deviceOptions.push_back(opt);
+        } else if (arg == "--outputs") {
+            printOutputs = true;
+        } else if (arg == "--cross-check") {
+            accelerate = true;
+            crossCheck = true;
+        } else if (programPath.empty() && arg[0] != '-') {
+            programPath = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (programPath.empty()) { PrintUsage(); return 1; }
+    bool profiling = !profileCSV.empty() || !profileJSON.empty();
+    bool observing = recordHistory || detectLoops || profiling || !tracePath.empty() || !callTracePath.empty() || !vcdPath.empty();
+    if (accelerate && observing) {
+        std::fprintf(stderr, "cpu_run: --accelerate-loops skips instructions, it cannot be combined with --history, --detect-loops, profiling or tracing\n");
+        return 1;
+    }
+    if (accelerate && (useJIT || lockstep)) {
+        std::fprintf(stderr, "cpu_run: --accelerate-loops runs on the switch or threaded engine, it cannot be combined with --engine jit or --lockstep\n");
+        return 1;
+    }
+    if (engineChosen && observing) {
+        std::fprintf(stderr, "cpu_run: --history, --detect-loops, profiling and tracing run on the interpreter, they cannot be combined with --engine or --lockstep\n");
+        return 1;
+    }
+
+    std::string source;
+    if (!ReadTextFile(programPath, source)) {
+        std::printf("RESULT status=compile_error line=-1 message=%s\n", QuoteField("Cannot open " + programPath).c_str());
+        return 1;
+    }
+
+    Assembler asmb;
+    CompileResult res = asmb.Assemble(source);
+    if (!res.success) {
+        std::printf("RESULT status=compile_error line=%d message=%s\n", res.errorLineIndex, QuoteField(res.errorMessage).c_str());
+        return 1;
+    }
+
+    CPU4bit cpu(engine);
+    cpu.LoadProgram(res.exe.machineCode, res.exe.initialRAM);
+    FifoInput input(inputs); // LDA 14 takes these inside the run loop; the run only stops once they are used up
+    cpu.SetInputProvider(&input);
+    OutputLog outputs;
+    if (printOutputs) cpu.SetOutputLog(&outputs);
+    std::vector<std::unique_ptr<Peripheral>> devices;
+    for (const DeviceOption& opt : deviceOptions)
+    {
+        devices.push_back(MakeDevice(opt, cpu));
+        cpu.AttachDevice((uint8_t)opt.address, devices.back().get());
+    }
+    CPU4bitJIT jit(cpu);
+    std::string divergence;
+    StateHistory history;
+    if (recordHistory) history.Begin(cpu.Snapshot());
+    LoopDetector loops;
+    loops.Reset(cpu);
+    ExecutionProfile profile;
+    RunObservers observers;
+    if (recordHistory) observers.history = &history;
+    if (detectLoops) observers.loops = &loops;
+    if (profiling) observers.profile = &profile;
+    TraceWriter trace;
+    if (!tracePath.empty()) {
+        if (!trace.Open(tracePath, cpu)) {
+            std::fprintf(stderr, "cpu_run: cannot write %s\n", tracePath.c_str());
+            return 1;
+        }
+        observers.trace = &trace;
+    }
+    CallTraceWriter callTrace;
+    if (!callTracePath.empty()) {
+        if (!callTrace.Open(callTracePath, cpu, res.exe.codeLabels, programPath)) {
+            std::fprintf(stderr, "cpu_run: cannot write %s\n", callTracePath.c_str());
+            return 1;
+        }
+        observers.calls = &callTrace;
+    }
+    VCDWriter vcd;
+    if (!vcdPath.empty()) {
+        if (!vcd.Open(vcdPath, cpu)) {
+            std::fprintf(stderr, "cpu_run: cannot write %s\n", vcdPath.c_str());
+            return 1;
+        }
+        observers.vcd = &vcd;
+    }
+    LoopAccelerator accelerator;
+    accelerator.crossCheck = crossCheck;
+
+    uint64_t executed = 0;
+    const char* status = "halted";
+    int exitCode = 0;
+
+    while (!cpu.isHalted())
+    {
+        if (cpu.isWaitingForInput) { status = "input"; exitCode = 3; break; }
+        if (executed >= budget) { status = "budget"; exitCode = 2; break; }
+        if (observers.OnlyTrace()) {
+            executed += trace.Run(cpu, budget - executed).executed;
+        } else if (observers.Any()) {
+            executed += cpu.RunHooked(observers, budget - executed).executed;
+            if (loops.Found()) { status = "loop"; exitCode = 5; break; }
+        } else if (accelerate) {
+            executed += accelerator.Run(cpu, budget - executed).executed;
+            if (accelerator.Mismatches() != 0) { divergence = accelerator.LastMismatch(); status = "diverged"; exitCode = 4; break; }
+        } else if (lockstep) {
+            uint64_t n = 0;
+            bool agreed = jit.RunLockstep(budget - executed, n, divergence);
+            executed += n;
+            if (!agreed) { status = "diverged"; exitCode = 4; break; }
+        } else if (useJIT) {
+            executed += jit.Run(budget - executed);
+        } else {
+            executed += cpu.RunFor(budget - executed).executed;
+        }
+    }
+
+    if (recordHistory) {
+        std::printf("HISTORY steps=%llu bytes=%zu bytes_per_step=%.2f\n", (unsigned long long)history.Steps(),
+            history.MemoryBytes(), history.Steps() ? (double)history.MemoryBytes() / history.Steps() : 0.0);
+        for (uint64_t step : stateSteps)
+        {
+            CPUState state;
+            if (history.StateAt(step, state)) std::printf("STATE step=%llu %s\n", (unsigned long long)step, StateFields(state).c_str());
+            else std::printf("STATE step=%llu unavailable\n", (unsigned long long)step);
+        }
+    }
+
+    if (loops.Found()) {
+        std::printf("LOOP length=%llu pc_min=%d pc_max=%d\n", (unsigned long long)loops.LoopLength(),
+            loops.LoopMinPC(), loops.LoopMaxPC());
+    }
+
+    if (accelerate) {
+        std::printf("ACCEL iterations=%llu instructions=%llu cross_checked=%d\n", (unsigned long long)accelerator.SkippedIterations(),
+            (unsigned long long)accelerator.SkippedInstructions(), crossCheck ? 1 : 0);
+    }
+
+    if (!profileCSV.empty() && !WriteTextFile(profileCSV, profile.ToCSV(cpu))) {
+        std::fprintf(stderr, "cpu_run: cannot write %s\n", profileCSV.c_str());
+    }
+    if (!profileJSON.empty() && !WriteTextFile(profileJSON, profile.ToJSON(cpu))) {
+        std::fprintf(stderr, "cpu_run: cannot write %s\n", profileJSON.c_str());
+    }
+
+    if (!tracePath.empty()) {
+        if (!trace.Close(cpu)) std::fprintf(stderr, "cpu_run: cannot write %s\n", tracePath.c_str());
+        std::printf("TRACE instructions=%llu record_bytes=%llu bytes_per_instruction=%.3f\n",
+            (unsigned long long)trace.Instructions(), (unsigned long long)trace.RecordBytes(),
+            trace.Instructions() ? (double)trace.RecordBytes() / trace.Instructions() : 0.0);
+    }
+
+    if (!callTracePath.empty()) {
+        if (!callTrace.Close(cpu)) std::fprintf(stderr, "cpu_run: cannot write %s\n", callTracePath.c_str());
+        std::printf("CALLS calls=%llu max_depth=%d\n", (unsigned long long)callTrace.Calls(), callTrace.MaxDepth());
+    }
+
+    if (!vcdPath.empty()) {
+        if (!vcd.Close()) std::fprintf(stderr, "cpu_run: cannot write %s\n", vcdPath.c_str());
+        std::printf("VCD cycles=%llu bytes=%llu\n", (unsigned long long)vcd.Cycles(), (unsigned long long)vcd.Bytes());
+    }
+
+    for (size_t d = 0; d < devices.size(); ++d)
+    {
+        const DeviceOption& opt = deviceOptions[d];
+        std::string extra;
+        if (opt.kind == "console") {
+            extra = " text=" + QuoteField(static_cast<const ConsoleDevice&>(*devices[d]).Text());
+        } else if (opt.kind == "capture") {
+            extra = " writes=" + FormatValueList(static_cast<const CaptureDevice&>(*devices[d]).Writes());
+        }
+        std::printf("DEVICE addr=%d kind=%s%s\n", (int)opt.address, opt.kind.c_str(), extra.c_str());
+    }
+
+    if (printOutputs) {
+        std::printf("OUTPUTS count=%llu dropped=%llu values=%s\n", (unsigned long long)outputs.Total(),
+            (unsigned long long)outputs.Oldest(), FormatValueList(outputs.Values()).c_str());
+    }
+
+    if (!divergence.empty()) std::fprintf(stderr, "cpu_run: %s\n", divergence.c_str());
+    std::printf("RESULT status=%s instructions=%llu %s\n", status, (unsigned long long)executed, StateFields(cpu.State()).c_str());
+    return exitCode;
+}
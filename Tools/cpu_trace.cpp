@@ -0,0 +1,93 @@
+// Trace reader: inspects a binary execution trace written by cpu_run --trace.
+//
+// Usage: cpu_trace <trace.bin> [--at N]... [--state-at N]... [--dump FIRST COUNT]
+//
+// Always prints one summary line:
+// TRACE instructions=N file_bytes=N record_bytes=N bytes_per_instruction=X index_entries=N
+// --at N adds a RECORD line for instruction N (random access through the index):
+// RECORD index=N pc=.. byte=.. jumped=0|1 [ram=CELL:VALUE] [stack=SLOT:VALUE] [out=VALUE]
+// --state-at N adds a STATE line with the machine state before instruction N
+// (N = instructions gives the final state). --dump prints RECORD lines for a range.
+// Exit codes: 0 ok, 1 usage error or unreadable trace, 2 a requested record/state is unavailable.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../Core/Trace.h"
+#include "HeadlessIO.h"
+
+static void PrintUsage(){
+    std::fprintf(stderr, "usage: cpu_trace <trace.bin> [--at N]... [--state-at N]... [--dump FIRST COUNT]\n");
+}
+
+static void PrintRecord(const TraceRecord& r){
+    std::printf("RECORD index=%llu pc=%d byte=%d jumped=%d", (unsigned long long)r.index, r.pc, r.byte, r.jumped ? 1 : 0);
+    if (r.ramCell >= 0) std::printf(" ram=%d:%d", r.ramCell, r.ramValue);
+    if (r.stackSlot >= 0) std::printf(" stack=%d:%d", r.stackSlot, r.stackValue);
+    if (r.output) std::printf(" out=%d", r.outputValue);
+    std::printf("\n");
+}
+
+int main(int argc, char** argv){
+    std::string tracePath;
+    std::vector<uint64_t> records, states;
+    uint64_t dumpFirst = 0, dumpCount = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        uint64_t n = 0;
+        if (arg == "--at" && hasValue) {
+            if (!ParseCount(argv[++i], n)) { PrintUsage(); return 1; }
+            records.push_back(n);
+        } else if (arg == "--state-at" && hasValue) {
+            if (!ParseCount(argv[++i], n)) { PrintUsage(); return 1; }
+            states.push_back(n);
+        } else if (arg == "--dump" && i + 2 < argc) {
+            if (!ParseCount(argv[i + 1], dumpFirst) || !ParseCount(argv[i + 2], dumpCount)) { PrintUsage(); return 1; }
+            i += 2;
+        } else if (tracePath.empty() && arg[0] != '-') {
+            tracePath = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (tracePath.empty()) { PrintUsage(); return 1; }
+
+    TraceReader reader;
+    std::string error;
+    if (!reader.Open(tracePath, error)) {
+        std::fprintf(stderr, "cpu_trace: %s\n", error.c_str());
+        return 1;
+    }
+
+    uint64_t count = reader.Instructions();
+    std::printf("TRACE instructions=%llu file_bytes=%llu record_bytes=%llu bytes_per_instruction=%.3f index_entries=%llu\n",
+        (unsigned long long)count, (unsigned long long)reader.FileBytes(), (unsigned long long)reader.RecordBytes(),
+        count ? (double)reader.RecordBytes() / count : 0.0, (unsigned long long)reader.IndexEntries());
+
+    int exitCode = 0;
+    TraceRecord record;
+    for (uint64_t n : records)
+    {
+        if (reader.At(n, record)) PrintRecord(record);
+        else { std::printf("RECORD index=%llu unavailable\n", (unsigned long long)n); exitCode = 2; }
+    }
+
+    if (dumpCount != 0) {
+        TraceReader::Cursor cursor;
+        if (!reader.Seek(dumpFirst, cursor)) { std::printf("RECORD index=%llu unavailable\n", (unsigned long long)dumpFirst); exitCode = 2; }
+        for (uint64_t k = 0; k < dumpCount && cursor.Next(record); ++k) PrintRecord(record);
+    }
+
+    for (uint64_t n : states)
+    {
+        CPUState state;
+        if (reader.StateAt(n, state)) std::printf("STATE step=%llu %s\n", (unsigned long long)n, StateFields(state).c_str());
+        else { std::printf("STATE step=%llu unavailable\n", (unsigned long long)n); exitCode = 2; }
+    }
+    return exitCode;
+}
@@ -4,6 +4,9 @@
 #include "raylib.h"
 #include "../Core/CPU.h"
 #include "../Core/Peripherals.h"
+#include "../Core/SimThread.h"
+#include "../Core/Profiler.h"
+#include "../Core/Breakpoints.h"
 #include "../Utils/Utils.h"
 #include "../Utils/Constants.h"
 
@@ -27,23 +30,53 @@ void DrawRegisters(const CPU4bit& cpu) {
     if(cpu.halted) DrawText("HALTED", 180, 230, 20, RED);
 }
 
-void DrawRAM(const CPU4bit& cpu) {
+// Blue (cold) to red (hot) by share of the hottest entry.
+inline Color HeatColor(uint64_t count, uint64_t max) {
+    float t = (max == 0) ? 0.0f : (float)count / (float)max;
+    return ColorFromHSV(240.0f * (1.0f - t), 0.85f, 0.9f);
+}
+
+// Returns the index of a clicked RAM cell, or -1; a right-clicked cell goes to `rightClicked`.
+// With a profile, cells are tinted by how often they were read and written; watched cells
+// are marked R (read) / W (write).
+int DrawRAM(const CPU4bit& cpu, const ExecutionProfile* profile = nullptr,
+            const Breakpoints* breakpoints = nullptr, int* rightClicked = nullptr) {
     int startX = 350; int startY = 120;
+    int clicked = -1;
     DrawText("RAM (DATA)", startX, 100, 20, LIGHTGRAY);
     for(int i=0; i<16; i++) {
         int x = startX + (i%4)*70;
         int y = startY + (i/4)*70;
         Color col = (i==14)?BLUE:(i==15?MAGENTA:COLOR_EDITOR);
+        Rectangle cell = { (float)x, (float)y, 60, 60 };
+        bool hovered = CheckCollisionPointRec(GetMousePosition(), cell);
+        if (hovered && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) clicked = i;
+        if (hovered && IsMouseButtonPressed(MOUSE_RIGHT_BUTTON) && rightClicked) *rightClicked = i;
         
         DrawRectangle(x, y, 60, 60, col);
-        DrawRectangleLines(x, y, 60, 60, GRAY);
+        if (profile) {
+            uint64_t accesses = profile->reads[i] + profile->writes[i];
+            if (accesses) DrawRectangle(x, y, 60, 60, Fade(HeatColor(accesses, profile->MaxCellAccesses()), 0.6f));
+            DrawText(TextFormat("r%llu w%llu", (unsigned long long)profile->reads[i], (unsigned long long)profile->writes[i]),
+                     x+22, y+47, 10, LIGHTGRAY);
+        }
+        DrawRectangleLines(x, y, 60, 60, hovered ? WHITE : GRAY);
 
         DrawText(TextFormat("%X", cpu.RAM[i]), x+20, y+20, 20, WHITE);
         DrawText(TextFormat("[%X]", i), x+2, y+45, 10, LIGHTGRAY);
+        if (breakpoints) {
+            bool r = (breakpoints->ReadWatch() >> i) & 1, w = (breakpoints->WriteWatch() >> i) & 1;
+            if (r || w) DrawText(r && w ? "RW" : (r ? "R" : "W"), x+42, y+3, 10, ORANGE);
+        }
     }
+    return clicked;
 }
 
-void DrawROM(const CPU4bit& cpu) {
+// With a profile, a heat column right of the disassembly shows how often each address ran
+// (and for JZ/JC how often the jump was taken / not taken). Breakpoints are drawn as dots
+// (orange: conditional). Returns the address of a clicked instruction line, or -1.
+int DrawROM(const CPU4bit& cpu, const ExecutionProfile* profile = nullptr, const Breakpoints* breakpoints = nullptr) {
+    int clicked = -1;
     int romX = 700; int romY = 120;
     DrawRectangle(romX, romY, 450, 400, COLOR_SIDEBAR);
     DrawRectangleLines(romX, romY, 450, 400, GRAY);
@@ -70,10 +103,73 @@ void DrawROM(const CPU4bit& cpu) {
         }
         std::string disasm = isAddr ? ("-> (Val: "+std::to_string(cpu.ROM[addr])+")") : Disassemble(cpu.ROM[addr]);
         DrawText(disasm.c_str(), romX+90, ly, 10, isAddr?SKYBLUE:WHITE);
+
+        Rectangle row = { (float)romX, (float)(ly-2), 450, 20 };
+        if (!isAddr && CheckCollisionPointRec(GetMousePosition(), row)) {
+            DrawRectangleLines(romX+2, ly-2, 446, 18, Fade(WHITE, 0.3f));
+            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) clicked = addr;
+        }
+        if (breakpoints && !isAddr && breakpoints->HasPC((uint8_t)addr)) {
+            DrawCircle(romX+14, ly+5, 4, breakpoints->HasCondition((uint8_t)addr) ? ORANGE : RED);
+        }
+
+        if (profile && !isAddr) {
+            uint64_t count = profile->executions[addr];
+            uint64_t hottest = profile->MaxExecutions();
+            int barW = (hottest == 0) ? 0 : (int)(60 * count / hottest);
+            if (count) DrawRectangle(romX+250, ly, barW > 0 ? barW : 1, 10, HeatColor(count, hottest));
+            DrawText(TextFormat("%llu", (unsigned long long)count), romX+315, ly, 10, count ? LIGHTGRAY : DARKGRAY);
+            if (profile->taken[addr] + profile->notTaken[addr]) {
+                DrawText(TextFormat("T%llu/N%llu", (unsigned long long)profile->taken[addr],
+                         (unsigned long long)profile->notTaken[addr]), romX+375, ly, 10, SKYBLUE);
+            }
+        }
     }
+    return clicked;
 }
 
-void DrawOutputPanel(CPU4bit& cpu) {
+// Scrollable list of the newest OUT values, formatted here as they are drawn. `scroll` counts
+// rows above the newest one (0 = follow new output); the mouse wheel changes it.
+void DrawOutputHistory(const OutputWindow& history, int* scroll, int x, int y, int w, int h) {
+    const int rowH = 12;
+    int rows = (h - 18) / rowH;
+    int count = (int)history.Count();
+    int maxScroll = count > rows ? count - rows : 0;
+    int offset = scroll ? *scroll : 0;
+
+    Rectangle box = { (float)x, (float)y, (float)w, (float)h };
+    if (scroll && CheckCollisionPointRec(GetMousePosition(), box)) {
+        float wheel = GetMouseWheelMove();
+        if (wheel != 0) offset += (wheel > 0) ? 1 : -1;
+    }
+    if (offset > maxScroll) offset = maxScroll;
+    if (offset < 0) offset = 0;
+    if (scroll) *scroll = offset;
+
+    DrawRectangleLinesEx(box, 1, GRAY);
+    DrawText(TextFormat("OUT HISTORY (%llu)", (unsigned long long)history.total), x + 6, y + 4, 10, LIGHTGRAY);
+
+    int newest = count - 1 - offset;
+    for (int r = 0; r < rows && newest - r >= 0; ++r)
+    {
+        int i = newest - r;
+        uint8_t v = history.values[i];
+        int rowY = y + h - 4 - (r + 1) * rowH; // newest at the bottom
+        DrawText(TextFormat("#%llu", (unsigned long long)(history.first + i)), x + 6, rowY, 10, GRAY);
+        DrawText(TextFormat("%3d  0x%X  %d%d%d%d", v, v, (v >> 3) & 1, (v >> 2) & 1, (v >> 1) & 1, v & 1),
+                 x + 70, rowY, 10, (r == 0 && offset == 0) ? COLOR_ACCENT : WHITE);
+    }
+
+    if (maxScroll > 0) { // scrollbar
+        int trackH = h - 18;
+        int thumbH = trackH * rows / count;
+        if (thumbH < 6) thumbH = 6;
+        int thumbY = y + 16 + (trackH - thumbH) * (maxScroll - offset) / maxScroll;
+        DrawRectangle(x + w - 5, thumbY, 3, thumbH, GRAY);
+    }
+}
+
+void DrawOutputPanel(const CPU4bit& cpu, const OutputWindow* history = nullptr, int* historyScroll = nullptr) {
     int panelX = 50; int panelY = 550;
     int panelW = 1100; int panelH = 100;
     
@@ -98,9 +194,14 @@ void DrawOutputPanel(CPU4bit& cpu) {
         DrawText(isLit ? "1" : "0", x-4, y-10, 20, WHITE);
         DrawText(TextFormat("LED %d", i), x-15, y+30, 10, GRAY);
     }
+
+    if (history) DrawOutputHistory(*history, historyScroll, panelX + 830, panelY + 6, 260, panelH - 12);
 }
 
-void DrawInputPopup(CPU4bit& cpu) {
+// The GUI's input provider: shown while LDA 14 waits, SEND queues the switch value on the sim
+// thread's FifoInput (keyboard digits do the same). Switch toggles also go to the sim thread;
+// the popup shows the switches of the last snapshot.
+void DrawInputPopup(const CPU4bit& cpu, SimThread& sim) {
     if (!cpu.isWaitingForInput) return; 
 
     DrawRectangle(0, 0, GetScreenWidth(), GetScreenHeight(), Fade(BLACK, 0.7f));
@@ -115,8 +216,7 @@ void DrawInputPopup(CPU4bit& cpu) {
     DrawText("INPUT REQUESTED (LDA 14)", boxX + 120, boxY + 20, 20, ORANGE);
     DrawText("Set Switches & Press Send", boxX + 140, boxY + 50, 10, LIGHTGRAY);
 
-    GPIO_Unit& gpio = cpu.getGPIO();
-    uint8_t switches = gpio.getSwitches();
+    uint8_t switches = cpu.getGPIO().getSwitches();
 
     for (int i = 3; i >= 0; i--) {
         int swX = boxX + 100 + (3-i) * 80;
@@ -127,7 +227,7 @@ void DrawInputPopup(CPU4bit& cpu) {
         
         if (CheckCollisionPointRec(GetMousePosition(), swRect)) {
             if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                gpio.ToggleSwitch(i); 
+                sim.Send(SIM_TOGGLE_SWITCH, i);
             }
             DrawRectangleLinesEx(swRect, 2, WHITE);
         }
@@ -151,10 +251,40 @@ void DrawInputPopup(CPU4bit& cpu) {
     DrawText("SEND DATA", boxX + 190, boxY + 235, 20, WHITE);
 
     if ((btnHover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) || IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_KP_ENTER)) {
-        cpu.ResolveInput(gpio.getSwitches());
+        sim.Send(SIM_INPUT, switches);
     }
 }
 
+inline const char* FormatHz(double hz) {
+    if (hz >= 1e6) return TextFormat("%.2f MHz", hz / 1e6);
+    if (hz >= 1e3) return TextFormat("%.1f kHz", hz / 1e3);
+    return TextFormat("%.1f Hz", hz);
+}
+
+// Clock rate selector (-/+), TURBO toggle and the achieved simulated frequency.
+void DrawClockControls(SimThread& sim, const SimSnapshot& snap) {
+    int x = 330; int y = 60;
+    if (DrawButton((Rectangle){(float)x, (float)y, 40, 40}, "-") || IsKeyPressed(KEY_MINUS)) sim.Send(SIM_SLOWER);
+    if (DrawButton((Rectangle){(float)x + 200, (float)y, 40, 40}, "+") || IsKeyPressed(KEY_EQUAL)) sim.Send(SIM_FASTER);
+    if (DrawButton((Rectangle){(float)x + 250, (float)y, 100, 40}, "TURBO") || IsKeyPressed(KEY_T)) sim.Send(SIM_TOGGLE_TURBO);
+    if (snap.turbo) DrawRectangleLinesEx((Rectangle){(float)x + 250, (float)y, 100, 40}, 2, ORANGE);
+
+    double rate = SimClock::RATES[snap.rateIndex];
+    const char* target = snap.turbo ? "TURBO" : (rate == 0 ? "UNLIMITED" : FormatHz(rate));
+    int textW = MeasureText(target, 20);
+    DrawText(target, x + 120 - textW / 2, y + 4, 20, snap.turbo ? ORANGE : WHITE);
+    bool running = snap.running && !snap.state.isWaitingForInput;
+    DrawText(running ? TextFormat("achieved %s", FormatHz(snap.achievedRate)) : "paused",
+             x + 55, y + 28, 10, GRAY);
+}
+
+// Shown instead of the CPU panels while a turbo run is in progress.
+void DrawTurboOverlay(uint64_t executed) {
+    DrawText("TURBO RUN...", 50, 300, 40, ORANGE);
+    DrawText(TextFormat("%llu instructions executed, state is shown on HLT or input request",
+             (unsigned long long)executed), 50, 350, 20, GRAY);
+}
+
 void DrawLanguageButton() {
     int screenWidth = GetScreenWidth();
     
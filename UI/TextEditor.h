@@ -6,6 +6,7 @@
 #include <string>
 #include <sstream>
 #include <algorithm> 
+#include <set>
 #include "../Utils/Constants.h"
 #include "../Core/InstructionSet.h"
 
@@ -43,6 +44,7 @@ public:
     float scrollOffsetY = 0.0f;
 
     int errorLine = -1;
+    std::set<int> breakpointLines; // toggled by clicking the line-number gutter
     
     Font editorFont;      
     bool fontLoaded = false;
@@ -196,6 +198,7 @@ public:
         if (lines.empty()) lines.push_back("");
         cursor = {0,0};
         errorLine = -1;
+        breakpointLines.clear();
     }
 
     std::string GetFullText(){
@@ -373,8 +376,17 @@ public:
                 scrollOffsetY -= wheel * fontSize * 3; 
                 if (scrollOffsetY < 0) scrollOffsetY = 0;
             }
+            bool inGutter = mouse.x < 56; // text starts at x = 60
+            // Gutter click: breakpoint on that line
+            if (inGutter && IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+            {
+                int clickedLine = (mouse.y - 70 + scrollOffsetY) / (int)fontSize;
+                if (clickedLine >= 0 && clickedLine < (int)lines.size()) {
+                    if (!breakpointLines.erase(clickedLine)) breakpointLines.insert(clickedLine);
+                }
+            }
             // Click
-            if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+            else if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
             {
                 int clickedLine = (mouse.y - 70 + scrollOffsetY) / (int)fontSize;
                 if (clickedLine < 0) clickedLine = 0;
@@ -404,7 +416,7 @@ public:
                 lastClickPos = newPos;
             }
             // Drag
-            if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
+            if (!inGutter && IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
                 int currentLine = (mouse.y - 70 + scrollOffsetY) / (int)fontSize;
                 if (currentLine < 0) currentLine = 0;
                 if (currentLine >= lines.size()) currentLine = lines.size() - 1;
@@ -547,6 +559,7 @@ public:
                 DrawRectangle(22, posY, 1156, (int)fontSize, Fade(WHITE, 0.05f));
             }
 
+            if (breakpointLines.count((int)i)) DrawCircle(26, posY + (int)fontSize / 2, 4, RED);
             DrawTextEx(editorFont, TextFormat("%2d", i+1), {(float)30, (float)posY}, fontSize, charSpacing, GRAY);
 
             std::string line = lines[i];
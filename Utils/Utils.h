@@ -53,6 +53,15 @@ inline std::string SaveFileDialog() {
     return "";
 }
 
+// Save dialog for exported reports; the chosen extension (.csv or .json) picks the format.
+inline std::string SaveReportDialog(const char* defaultName) {
+    const char* filters[2] = { "*.csv", "*.json" };
+    const char* path = tinyfd_saveFileDialog("Export Profile", defaultName, 2, filters, "CSV / JSON");
+
+    if (path != NULL) return std::string(path);
+    return "";
+}
+
 inline bool DrawButton(Rectangle rect, const char* text){
     Vector2 mouse = GetMousePosition();
     bool hovered = CheckCollisionPointRec(mouse,rect);
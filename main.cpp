@@ -5,6 +5,7 @@
 #include "UI/TextEditor.h"
 #include "UI/SimulationUI.h"
 #include "Core/CPU.h"
+#include "Core/SimThread.h"
 #include "Core/Assembler.h"
 
 #if defined(__APPLE__)
@@ -43,7 +44,11 @@ int main(){
     AppState currState = STATE_EDITOR;
 
     Assembler asmb;
-    CPU4bit cpu;
+    // The CPU runs on the sim thread; `view` holds the loaded ROM plus the latest published state
+    SimThread sim;
+    sim.Start();
+    CPU4bit view;
+    uint32_t viewProgram = 0;
     TextEditor editor;
     editor.SetFont(codeFont, 20.0f);
 
@@ -53,12 +58,15 @@ int main(){
 
     std::string msg = "Ready.";
     Color msgColor = GRAY;
-
-    bool autoRun = false;
-    float runTimer = 0.0f;
+    Breakpoints breakpoints; // UI copy; every change is sent whole to the sim thread
+    int outputScroll = 0;    // OUT history rows scrolled back from the newest
 
     while (!WindowShouldClose())
     {     
+        if (sim.Update() && sim.Latest().programId == viewProgram) view.State() = sim.Latest().state;
+        const SimSnapshot& snap = sim.Latest();
+        bool autoRun = snap.running;
+
         bool isCtrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL) || 
                       IsKeyDown(KEY_LEFT_SUPER)   || IsKeyDown(KEY_RIGHT_SUPER);
 
@@ -67,36 +75,37 @@ int main(){
             editor.HandleInput();
         }else if (currState == STATE_SIMULATION)
         {
-            if (cpu.isWaitingForInput)
+            if (view.isWaitingForInput)
             {
                 int key = GetKeyPressed();
                 int inputVal = -1;
                 if (key >= KEY_ZERO && key <= KEY_NINE) inputVal = key - KEY_ZERO;
                 else if (key >= KEY_KP_0 && key <= KEY_KP_9) inputVal = key - KEY_KP_0;
                 else if (key >= KEY_A && key <= KEY_F) inputVal = 10 + (key - KEY_A);
-                if (inputVal != -1) cpu.ResolveInput(inputVal);
+                if (inputVal != -1) sim.Send(SIM_INPUT, inputVal);
             }else {
                 if (IsKeyPressed(KEY_S) || IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_ENTER)) {
-                    if(!cpu.isHalted()) { cpu.Fetch(); cpu.Execute(); }
-                    autoRun = false; 
+                    sim.Send(SIM_STEP);
                 }
                 
                 if (IsKeyPressed(KEY_R)) {
-                    autoRun = !autoRun;
+                    sim.Send(SIM_TOGGLE_RUN);
                 }
 
                 if (IsKeyPressed(KEY_BACKSPACE)) {
-                    cpu.Reset();
-                    autoRun = false;
+                    sim.Send(SIM_RESET);
                 }
 
-                if (autoRun) {
-                    runTimer += GetFrameTime();
-                    if (runTimer >= 0.1f) {
-                        runTimer = 0;
-                        if (!cpu.isHalted()) { cpu.Fetch(); cpu.Execute(); }
-                        else autoRun = false;
-                    }
+                if (IsKeyPressed(KEY_B)) {
+                    sim.Send(SIM_STEP_BACK);
+                }
+
+                if (IsKeyPressed(KEY_P)) {
+                    sim.Send(SIM_TOGGLE_PROFILE);
+                }
+
+                if (IsKeyPressed(KEY_J)) {
+                    sim.Send(SIM_TOGGLE_JOURNAL);
                 }
             }
         }
@@ -109,7 +118,7 @@ int main(){
 
         if (DrawButton((Rectangle){150,5,100,40},"EDITOR") || IsKeyPressed(KEY_E))
         {
-            currState = STATE_EDITOR;autoRun=false;
+            currState = STATE_EDITOR;sim.Send(SIM_PAUSE);
         }
         
         if (currState == STATE_EDITOR)
@@ -118,8 +127,34 @@ int main(){
                 CompileResult res = asmb.Assemble(editor.GetFullText());
                 if (res.success)
                 {
-                    cpu.LoadProgram(res.exe.machineCode,res.exe.initialRAM);
-                    cpu.consoleBuffer = "Compilation Successful.";
+                    // Gutter breakpoints map to the instruction of their line; "; if COND" makes one conditional
+                    breakpoints.Clear();
+                    for (int line : editor.breakpointLines)
+                    {
+                        auto at = res.exe.lineAddresses.find(line);
+                        if (at == res.exe.lineAddresses.end() || line >= (int)editor.lines.size()) continue;
+                        BreakCondition condition;
+                        std::string error;
+                        if (!BreakCondition::FromSourceLine(editor.lines[line], condition, error)) {
+                            res.success = false;
+                            res.errorMessage = "Breakpoint condition: " + error;
+                            res.errorLineIndex = line;
+                            break;
+                        }
+                        if (!breakpoints.SetPC((uint8_t)at->second, condition)) {
+                            res.success = false;
+                            res.errorMessage = "Too many conditional breakpoints (max 16)";
+                            res.errorLineIndex = line;
+                            break;
+                        }
+                    }
+                }
+                if (res.success)
+                {
+                    view.LoadProgram(res.exe.machineCode,res.exe.initialRAM);
+                    view.SetConsoleEvent(CONSOLE_COMPILED);
+                    viewProgram = sim.LoadProgram(res.exe.machineCode,res.exe.initialRAM);
+                    sim.SetBreakpoints(breakpoints);
                     currState = STATE_SIMULATION;
 
                     msg = "Ready.";         
@@ -158,25 +193,52 @@ int main(){
         }else
         {
             DrawRectangleLinesEx((Rectangle){260, 5, 120, 40}, 2, GREEN);
+            if (DrawButton((Rectangle){490, 5, 100, 40}, "PROFILE")) sim.Send(SIM_TOGGLE_PROFILE);
+            if (snap.profiling) DrawRectangleLinesEx((Rectangle){490, 5, 100, 40}, 2, ORANGE);
+            if (snap.profiling && DrawButton((Rectangle){600, 5, 100, 40}, "EXPORT")) {
+                std::string path = SaveReportDialog("profile.csv");
+                if (!path.empty()) {
+                    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+                    SaveFile(path, json ? snap.profile.ToJSON(view) : snap.profile.ToCSV(view));
+                }
+            }
             if (DrawButton((Rectangle){50, 60, 80, 40}, "STEP")) {
-                if(!cpu.isHalted() && !cpu.isWaitingForInput) { cpu.Fetch(); cpu.Execute(); }
-                autoRun = false;
+                sim.Send(SIM_STEP);
             }
-            if (DrawButton((Rectangle){140, 60, 80, 40}, autoRun?"PAUSE":"RUN")) autoRun = !autoRun;
+            if (DrawButton((Rectangle){140, 60, 80, 40}, autoRun?"PAUSE":"RUN")) sim.Send(SIM_TOGGLE_RUN);
             if (DrawButton((Rectangle){230, 60, 80, 40}, "RESET")) {
-                cpu.Reset();
-                autoRun = false; 
+                sim.Send(SIM_RESET);
+            }
+            DrawClockControls(sim, snap);
+            if (DrawButton((Rectangle){690, 60, 120, 40}, "STEP BACK")) sim.Send(SIM_STEP_BACK);
+            DrawText("Shortcuts: [Space/Enter]: Step | [B]: Step Back | [R]: Run/Stop", 820, 60, 10, GRAY);
+            DrawText("[<=]: Reset | [-/+]: Clock | [T]: Turbo | [P]: Profile", 820, 74, 10, GRAY);
+            DrawText(TextFormat("Click a RAM cell: reverse to its last write (undo depth %llu) | [J]: Journal runs %s",
+                     (unsigned long long)snap.undoDepth, snap.journaling ? "ON" : "OFF"), 820, 88, 10, GRAY);
+            DrawText("Click a ROM line: breakpoint | Right-click a RAM cell: watch W/RW/R", 820, 102, 10, GRAY);
+            if (snap.breakHit.kind == BREAK_PC) DrawText(TextFormat("BREAK at PC %d", snap.breakHit.where), 50, 330, 20, RED);
+            else if (snap.breakHit.kind == BREAK_READ) DrawText(TextFormat("WATCH read [%d]", snap.breakHit.where), 50, 330, 20, ORANGE);
+            else if (snap.breakHit.kind == BREAK_WRITE) DrawText(TextFormat("WATCH write [%d]", snap.breakHit.where), 50, 330, 20, ORANGE);
+            else if (snap.noEarlierWrite >= 0) DrawText(TextFormat("No earlier write to [%d] in the journal", snap.noEarlierWrite), 50, 330, 20, GRAY);
+            if (autoRun && snap.turbo && !view.isWaitingForInput) {
+                DrawTurboOverlay(snap.runExecuted);
+            } else {
+                DrawRegisters(view);
+                const ExecutionProfile* profile = snap.profiling ? &snap.profile : nullptr;
+                int watchCell = -1;
+                int cell = DrawRAM(view, profile, &breakpoints, &watchCell);
+                if (cell >= 0 && !view.isWaitingForInput) sim.Send(SIM_REVERSE_TO_WRITE, cell);
+                if (watchCell >= 0) { breakpoints.CycleWatch((uint8_t)watchCell); sim.SetBreakpoints(breakpoints); }
+                int addr = DrawROM(view, profile, &breakpoints);
+                if (addr >= 0) { breakpoints.TogglePC((uint8_t)addr); sim.SetBreakpoints(breakpoints); }
+                DrawOutputPanel(view, snap.programId == viewProgram ? &snap.outputs : nullptr, &outputScroll);
             }
-            DrawText("Shortcuts: [Space/Enter]: Step | [R]: Run/Stop | [<=]: Reset", 350, 70, 10, GRAY);
-            DrawRegisters(cpu);
-            DrawRAM(cpu);
-            DrawROM(cpu);
-            DrawOutputPanel(cpu); 
-            DrawInputPopup(cpu);
+            DrawInputPopup(view, sim);
             DrawLanguageButton();
         }
         EndDrawing();
     }
+    sim.Stop();
     UnloadFont(codeFont);
     CloseWindow();
     return 0;